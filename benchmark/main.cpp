@@ -0,0 +1,101 @@
+/*
+ * This file is part of the Novile Editor
+ * This program is free software licensed under the GNU LGPL. You can
+ * find a copy of this license in LICENSE in the top directory of
+ * the source code.
+ *
+ * Copyright 2013    Illya Kovalevskyy   <illya.kovalevskyy@gmail.com>
+ *
+ */
+
+/*
+ * Times the calls, which cross the boundary between C++ and the page, on
+ * a large document. Build it with -DBUILD_BENCHMARK=Yes, once with the
+ * default QtWebKit backend and once with -DNOVILE_WEBENGINE=Yes, and
+ * compare the output:
+ *
+ *     novile_benchmark [lines] [calls]
+ */
+
+#include <cstdio>
+
+#include <QtCore>
+#include <QApplication>
+#include "editor.h"
+
+using namespace Novile;
+
+static void report(const char *name, qint64 nsecs, int calls)
+{
+    printf("%-28s %10.3f ms total %10.3f ms per call\n", name,
+           nsecs / 1e6, nsecs / 1e6 / calls);
+    fflush(stdout);
+}
+
+static QString document(int lines)
+{
+    QStringList result;
+    result.reserve(lines);
+    for (int i = 0; i < lines; ++i)
+        result << QString("    value_%1 = compute(%1, \"line %1\"); // comment").arg(i);
+    return result.join("\n");
+}
+
+int main(int argc, char *argv[])
+{
+    QApplication app(argc, argv);
+
+    const QStringList args = app.arguments();
+    const int lines = args.size() > 1 ? args.at(1).toInt() : 200000;
+    const int calls = args.size() > 2 ? args.at(2).toInt() : 1000;
+
+#ifdef NOVILE_WEBENGINE
+    printf("Backend: QtWebEngine, %d lines, %d calls\n", lines, calls);
+#else
+    printf("Backend: QtWebKit, %d lines, %d calls\n", lines, calls);
+#endif
+
+    QElapsedTimer timer;
+    timer.start();
+    Editor editor;
+    editor.resize(800, 600);
+    editor.show();
+    report("start of the editor", timer.nsecsElapsed(), 1);
+
+    const QString text = document(lines);
+
+    // selections() waits for the page, so the document is set when it returns
+    timer.restart();
+    editor.setText(text);
+    editor.selections();
+    report("setText()", timer.nsecsElapsed(), 1);
+
+    timer.restart();
+    int length = 0;
+    for (int i = 0; i < calls; ++i)
+        length += editor.text().size();
+    report("text()", timer.nsecsElapsed(), calls);
+
+    timer.restart();
+    int ranges = 0;
+    for (int i = 0; i < calls; ++i)
+        ranges += editor.selections().size();
+    report("selections()", timer.nsecsElapsed(), calls);
+
+    // Edits don't wait for the page, their changes come back as deltas:
+    // the last one has to reach the document
+    const int lastRow = (calls - 1) % lines;
+    timer.restart();
+    for (int i = 0; i < calls; ++i)
+        editor.insert(i % lines, 0, "x");
+    while (!editor.line(lastRow).startsWith('x') && timer.elapsed() < 10000)
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+    report("insert() + changes back", timer.nsecsElapsed(), calls);
+
+    if (!editor.line(lastRow).startsWith('x'))
+        printf("Changes haven't reached the document\n");
+
+    Q_UNUSED(length);
+    Q_UNUSED(ranges);
+    return 0;
+}
@@ -8,32 +8,50 @@
  *
  */
 
-function property(param, value) {
-    if (arguments.length == 1) {
-        // Get
-        return sessionStorage[param];
-    } else {
-        // Set
-        sessionStorage[param] = value;
-    }
+// Tiny synchronous script loader (used for modes and themes)
+// Each script is fetched and evaluated only once per page
+var loadedScripts = {};
+
+function loadScript(url) {
+    if (loadedScripts[url])
+        return true;
+
+    var request = new XMLHttpRequest();
+    request.open('GET', url, false);
+    request.send(null);
+
+    // qrc:/ and file:/ requests report status 0 on success
+    if (request.status != 0 && request.status != 200)
+        return false;
+
+    var script = document.createElement('script');
+    script.type = 'text/javascript';
+    script.text = request.responseText;
+    document.head.appendChild(script);
+    document.head.removeChild(script);
+
+    loadedScripts[url] = true;
+    return true;
 }
 
-property("lines", 1);
-property("text", "");
+// Changes are counted instead of keeping a copy of the document to compare
+// with: the copy doubled memory and did not fit sessionStorage quota for
+// large files, so changes stopped being reported
+var lastLines = 1;
+var pendingChanges = 0;
 
 var timerid = -1;
 
 // All necessary calls here
 function handleEvents() {
     var newLines = editor.session.getLength();
-    if (newLines != property("lines")) {
-        property("lines", newLines);
+    if (newLines != lastLines) {
+        lastLines = newLines;
         Novile.onLinesChanged(newLines);
     }
 
-    var newText = editor.getValue();
-    if (newText != property("text")) {
-        property("text", newText);
+    if (pendingChanges > 0) {
+        pendingChanges = 0;
         Novile.onTextChanged();
     }
 
@@ -45,9 +63,562 @@ function handleEvents() {
 // Some events haven't been finished yet
 // Thats why we schedule it
 editor.on('change', function() {
+    ++pendingChanges;
+
     if (timerid > 0) {
         clearTimeout(timerid);
     }
 
     timerid = setTimeout(handleEvents, 50);
 });
+
+// Cursor position and selection are pushed to Novile on each change,
+// so C++ side reads them from cache instead of polling
+editor.selection.on('changeCursor', function() {
+    var cursor = editor.getCursorPosition();
+    Novile.onCursorPositionChanged(cursor.row, cursor.column);
+});
+
+editor.on('changeSelection', function() {
+    Novile.onSelectionChanged();
+});
+
+// Scroll position is pushed as the first visible line, when it changes
+var firstVisibleRow = 0;
+
+editor.session.on('changeScrollTop', function(scrollTop) {
+    var lineHeight = editor.renderer.lineHeight;
+    if (!lineHeight)
+        return;
+
+    var row = editor.session.screenToDocumentRow(Math.floor(scrollTop / lineHeight), 0);
+    if (row != firstVisibleRow) {
+        firstVisibleRow = row;
+        Novile.onFirstVisibleLineChanged(row);
+    }
+});
+
+// Initial state (cursor could be moved before wrapper was loaded)
+(function() {
+    var cursor = editor.getCursorPosition();
+    Novile.onCursorPositionChanged(cursor.row, cursor.column);
+})();
+
+// Marker layers: layer -> {"startRow,startColumn,endRow,endColumn": marker id}
+var markerLayers = {};
+
+// Ace marker types of the layers ('text' by default)
+var markerTypes = {};
+
+// Ranges are flattened: [startRow, startColumn, endRow, endColumn, ...]
+function updateMarkers(layer, removed, added) {
+    var Range = ace.require('ace/range').Range;
+    var session = editor.session;
+    var markers = markerLayers[layer] || (markerLayers[layer] = {});
+    var key, i;
+
+    for (i = 0; i < removed.length; i += 4) {
+        key = removed.slice(i, i + 4).join(',');
+        session.removeMarker(markers[key]);
+        delete markers[key];
+    }
+
+    for (i = 0; i < added.length; i += 4) {
+        key = added.slice(i, i + 4).join(',');
+        var range = new Range(added[i], added[i + 1], added[i + 2], added[i + 3]);
+        markers[key] = session.addMarker(range, 'novile_' + layer, markerTypes[layer] || 'text', false);
+    }
+}
+
+// Styles of the layers: layer -> [css, fullLine] (kept for hibernation)
+var markerStyles = {};
+
+function setMarkerStyle(layer, css, fullLine) {
+    markerTypes[layer] = fullLine ? 'fullLine' : 'text';
+    markerStyles[layer] = [css, fullLine];
+    var id = 'novile_style_' + layer;
+    var style = document.getElementById(id);
+    if (!style) {
+        style = document.createElement('style');
+        style.id = id;
+        document.head.appendChild(style);
+    }
+    style.textContent = '.novile_' + layer + ' { position: absolute; ' + css + ' }';
+}
+
+// Every change of the document is pushed to Novile, which keeps its copy,
+// so reading and saving the document doesn't need any JavaScript calls.
+// Changes are stamped with the generation of the document (set by Novile
+// with the whole text): with QtWebEngine they arrive asynchronously, and
+// ones of the previous document are dropped. sentDeltas lets Novile wait
+// for the changes, which are still on the way.
+var silentChanges = false;
+var documentGeneration = 0;
+var sentDeltas = 0;
+
+editor.on('change', function(e) {
+    if (silentChanges)
+        return;
+
+    var delta = e.data;
+    var start = delta.range.start;
+    var end = delta.range.end;
+    var generation = documentGeneration;
+
+    switch (delta.action) {
+    case 'insertText':
+        Novile.onDocumentInsert(generation, start.row, start.column, delta.text);
+        break;
+    case 'insertLines':
+        Novile.onDocumentInsert(generation, start.row, 0, delta.lines.join('\n') + '\n');
+        break;
+    case 'removeText':
+    case 'removeLines':
+        Novile.onDocumentRemove(generation, start.row, start.column, end.row, end.column);
+        break;
+    default:
+        return;
+    }
+    sentDeltas++;
+});
+
+// Replace the whole document, Novile already knows new text
+function setDocumentText(text, generation) {
+    silentChanges = true;
+    editor.session.setValue(text);
+    silentChanges = false;
+    documentGeneration = generation;
+    sentDeltas = 0;
+}
+
+// Multiple selections, ranges are flattened like for markers
+function setSelections(ranges) {
+    var Range = ace.require('ace/range').Range;
+    var selection = editor.selection;
+    if (ranges.length < 4)
+        return;
+
+    selection.toSingleRange(new Range(ranges[0], ranges[1], ranges[2], ranges[3]));
+    for (var i = 4; i < ranges.length; i += 4) {
+        var range = new Range(ranges[i], ranges[i + 1], ranges[i + 2], ranges[i + 3]);
+        // Change events are fired only once, for the last range
+        selection.addRange(range, i + 4 < ranges.length);
+    }
+}
+
+function getSelections() {
+    var ranges = editor.selection.getAllRanges();
+    var flat = [];
+    for (var i = 0; i < ranges.length; ++i) {
+        var range = ranges[i];
+        flat.push(range.start.row, range.start.column, range.end.row, range.end.column);
+    }
+    return flat;
+}
+
+// Edits are flattened: [startRow, startColumn, endRow, endColumn, text, ...]
+// and applied in the given order (bottom-up keeps positions valid)
+function replaceRanges(edits) {
+    var Range = ace.require('ace/range').Range;
+    var session = editor.session;
+    for (var i = 0; i < edits.length; i += 5)
+        session.replace(new Range(edits[i], edits[i + 1], edits[i + 2], edits[i + 3]), edits[i + 4]);
+}
+
+function insertAtAllCursors(text) {
+    editor.forEachSelection({exec: function(ed) { ed.insert(text); }});
+}
+
+// Fold ranges provided by Novile: start row -> [startRow, startColumn, endRow, endColumn]
+// If they are set, Ace doesn't compute fold widgets itself
+var providedFolds = null;
+
+var providedFoldMode = {
+    getFoldWidget: function(session, foldStyle, row) {
+        return providedFolds[row] ? 'start' : '';
+    },
+    getFoldWidgetRange: function(session, foldStyle, row) {
+        var fold = providedFolds[row];
+        if (!fold)
+            return null;
+
+        var Range = ace.require('ace/range').Range;
+        return new Range(fold[0], fold[1], fold[2], fold[3]);
+    }
+};
+
+function applyFoldMode() {
+    var session = editor.session;
+    session.$setFolding(null);
+    session.$setFolding(providedFolds ? providedFoldMode : session.$mode.foldingRules);
+}
+
+// Ranges are flattened like for markers, null returns folding to the mode
+function setFoldRanges(ranges) {
+    if (ranges) {
+        providedFolds = {};
+        for (var i = 0; i < ranges.length; i += 4)
+            providedFolds[ranges[i]] = ranges.slice(i, i + 4);
+    } else {
+        providedFolds = null;
+    }
+    applyFoldMode();
+}
+
+// Mode brings its own folding rules: provided ranges have priority
+editor.session.on('changeMode', function() {
+    if (providedFolds)
+        applyFoldMode();
+});
+
+// Brackets can be highlighted by Novile from its own index, then Ace
+// doesn't scan the document for them on each cursor move
+function setNativeBracketMatching(enabled) {
+    var session = editor.session;
+    if (enabled) {
+        editor.$highlightBrackets = function() {};
+        if (session.$bracketHighlight) {
+            session.removeMarker(session.$bracketHighlight);
+            session.$bracketHighlight = null;
+        }
+    } else {
+        delete editor.$highlightBrackets;
+        editor.$highlightBrackets();
+    }
+}
+
+// Completion popup: words come from Novile's index of all open documents
+var completion = null;
+var completionKeys = new (ace.require('ace/keyboard/hash_handler').HashHandler)();
+
+function selectCompletion(index) {
+    var items = completion.list.childNodes;
+    items[completion.selected].className = '';
+    completion.selected = (index + items.length) % items.length;
+    items[completion.selected].className = 'selected';
+    items[completion.selected].scrollIntoView(false);
+}
+
+function insertCompletion() {
+    var word = completion.words[completion.selected];
+    var prefixLength = completion.prefix.length;
+    closeCompletion();
+    editor.insert(word.substring(prefixLength));
+}
+
+function closeCompletion() {
+    if (!completion)
+        return;
+
+    document.body.removeChild(completion.list);
+    editor.keyBinding.removeKeyboardHandler(completionKeys);
+    editor.off('changeSelection', closeCompletion);
+    editor.off('blur', closeCompletion);
+    completion = null;
+}
+
+completionKeys.bindKeys({
+    'Up': function() { selectCompletion(completion.selected - 1); },
+    'Down': function() { selectCompletion(completion.selected + 1); },
+    'Return': function() { insertCompletion(); },
+    'Tab': function() { insertCompletion(); },
+    'Esc': function() { closeCompletion(); }
+});
+
+// Start of the word before the cursor
+function completionStart(cursor) {
+    var line = editor.session.getLine(cursor.row);
+    var start = cursor.column;
+    while (start > 0 && /[\w$]/.test(line.charAt(start - 1)))
+        --start;
+    return start;
+}
+
+// Words come back to openCompletions()
+function showCompletions() {
+    closeCompletion();
+
+    var cursor = editor.getCursorPosition();
+    var start = completionStart(cursor);
+    Novile.requestCompletions(editor.session.getLine(cursor.row).substring(start, cursor.column));
+}
+
+function openCompletions(prefix, words) {
+    closeCompletion();
+
+    // Cursor could have moved, while words were looked up
+    var cursor = editor.getCursorPosition();
+    var start = completionStart(cursor);
+    if (editor.session.getLine(cursor.row).substring(start, cursor.column) != prefix)
+        return;
+
+    if (!words.length)
+        return;
+
+    if (words.length == 1) {
+        editor.insert(words[0].substring(prefix.length));
+        return;
+    }
+
+    var list = document.createElement('ul');
+    list.className = 'novile_completion';
+    for (var i = 0; i < words.length; ++i) {
+        var item = document.createElement('li');
+        item.textContent = words[i];
+        list.appendChild(item);
+    }
+
+    var position = editor.renderer.textToScreenCoordinates(cursor.row, start);
+    list.style.left = position.pageX + 'px';
+    list.style.top = (position.pageY + editor.renderer.lineHeight) + 'px';
+    document.body.appendChild(list);
+
+    completion = {list: list, words: words, prefix: prefix, selected: 0};
+    list.firstChild.className = 'selected';
+
+    editor.keyBinding.addKeyboardHandler(completionKeys);
+    editor.on('changeSelection', closeCompletion);
+    editor.on('blur', closeCompletion);
+}
+
+editor.commands.addCommand({
+    name: 'showCompletions',
+    bindKey: {win: 'Ctrl-Space', mac: 'Ctrl-Space'},
+    exec: showCompletions
+});
+
+// Background tokenizer works in chunks: rows are tokenized until the time
+// budget is spent (checked each rowsPerCheck rows), then it sleeps for the
+// interval, so painting gets its frames. Same loop as Ace's one, but tunable
+var tokenizerConfig = {budget: 20, interval: 20, rowsPerCheck: 5, paused: false};
+
+// Editor is hidden: nothing works in the background
+var suspended = false;
+
+function installTokenizerWorker(session) {
+    var tokenizer = session.bgTokenizer;
+    tokenizer.$worker = function() {
+        if (!tokenizer.running)
+            return;
+
+        tokenizer.running = false;
+        if (tokenizerConfig.paused || suspended)
+            return;
+
+        var started = new Date();
+        var row = tokenizer.currentLine;
+        var length = tokenizer.doc.getLength();
+        var last = -1;
+        var count = 0;
+
+        while (tokenizer.lines[row])
+            row++;
+
+        var first = row;
+        while (row < length) {
+            tokenizer.$tokenizeRow(row);
+            last = row;
+            do {
+                row++;
+            } while (tokenizer.lines[row]);
+
+            if (++count % tokenizerConfig.rowsPerCheck === 0 &&
+                    new Date() - started > tokenizerConfig.budget) {
+                tokenizer.running = setTimeout(tokenizer.$worker, tokenizerConfig.interval);
+                break;
+            }
+        }
+
+        tokenizer.currentLine = row;
+        if (first <= last)
+            tokenizer.fireUpdateEvent(first, last);
+    };
+}
+
+installTokenizerWorker(editor.session);
+editor.on('changeSession', function(e) {
+    installTokenizerWorker(e.session);
+});
+
+function setTokenizerBudget(budget, interval, rowsPerCheck) {
+    tokenizerConfig.budget = budget;
+    tokenizerConfig.interval = interval;
+    tokenizerConfig.rowsPerCheck = Math.max(rowsPerCheck, 1);
+}
+
+function setTokenizerPaused(paused) {
+    var tokenizer = editor.session.bgTokenizer;
+    tokenizerConfig.paused = paused;
+    if (paused) {
+        tokenizer.stop();
+    } else if (!suspended && !tokenizer.running) {
+        tokenizer.running = setTimeout(tokenizer.$worker, 0);
+    }
+}
+
+// Hidden editor stops tokenizer and cursor blinking; when it's shown
+// again, layout is refreshed (size could be changed meanwhile)
+function setSuspended(value) {
+    var tokenizer = editor.session.bgTokenizer;
+    suspended = value;
+    editor.renderer.$cursorLayer.setBlinking(!value);
+
+    if (value) {
+        tokenizer.stop();
+    } else {
+        if (!tokenizerConfig.paused && !tokenizer.running)
+            tokenizer.running = setTimeout(tokenizer.$worker, 0);
+        editor.resize(true);
+    }
+}
+
+// Part of the document, which is tokenized (0..1)
+function tokenizerProgress() {
+    var tokenizer = editor.session.bgTokenizer;
+    var length = editor.session.getLength();
+    return length ? Math.min(tokenizer.currentLine / length, 1) : 1;
+}
+
+// View state: selections, scroll, folds and undo history (see Editor::saveState)
+// Ranges are flattened like for markers, folds are followed by placeholders.
+// Undo entries keep document deltas only (fold deltas refer to live objects):
+// [action, startRow, startColumn, endRow, endColumn, text, ...], lines of
+// line deltas are terminated with '\n' each
+var deltaActions = ['insertText', 'insertLines', 'removeText', 'removeLines'];
+
+function getViewState() {
+    var session = editor.session;
+    var undoManager = session.getUndoManager();
+    session.$syncInformUndoManager();
+
+    function flatten(stack) {
+        var entries = [];
+        stack.forEach(function(entry) {
+            var flat = [];
+            entry.forEach(function(group) {
+                if (group.group != 'doc')
+                    return;
+
+                group.deltas.forEach(function(delta) {
+                    var range = delta.range;
+                    var text = delta.lines ? delta.lines.map(function(line) {
+                        return line + '\n';
+                    }).join('') : delta.text;
+                    flat.push(deltaActions.indexOf(delta.action),
+                              range.start.row, range.start.column,
+                              range.end.row, range.end.column, text);
+                });
+            });
+            if (flat.length)
+                entries.push(flat);
+        });
+        return entries;
+    }
+
+    var folds = [];
+    session.getAllFolds().forEach(function(fold) {
+        folds.push(fold.start.row, fold.start.column, fold.end.row, fold.end.column,
+                   fold.placeholder);
+    });
+
+    return {
+        selections: getSelections(),
+        scrollTop: session.getScrollTop(),
+        scrollLeft: session.getScrollLeft(),
+        folds: folds,
+        undo: flatten(undoManager.$undoStack),
+        redo: flatten(undoManager.$redoStack),
+        dirty: undoManager.dirtyCounter
+    };
+}
+
+// Counterpart of getViewState(), the document is set already
+function restoreViewState(json) {
+    var state = JSON.parse(json);
+    var Range = ace.require('ace/range').Range;
+    var session = editor.session;
+    var newLine = session.getDocument().getNewLineCharacter();
+
+    session.unfold();
+    for (var i = 0; i < state.folds.length; i += 5) {
+        var folds = state.folds;
+        try {
+            session.addFold(folds[i + 4],
+                            new Range(folds[i], folds[i + 1], folds[i + 2], folds[i + 3]));
+        } catch (e) {
+            // Overlapping fold: skip it
+        }
+    }
+
+    function revive(entries) {
+        return entries.map(function(flat) {
+            var deltas = [];
+            for (var i = 0; i < flat.length; i += 6) {
+                var delta = {
+                    action: deltaActions[flat[i]],
+                    range: new Range(flat[i + 1], flat[i + 2], flat[i + 3], flat[i + 4])
+                };
+                if (flat[i] == 1 || flat[i] == 3) {
+                    delta.lines = flat[i + 5].split('\n');
+                    delta.lines.pop();
+                    if (flat[i] == 3)
+                        delta.nl = newLine;
+                } else {
+                    delta.text = flat[i + 5];
+                }
+                deltas.push(delta);
+            }
+            return [{group: 'doc', deltas: deltas}];
+        });
+    }
+
+    var undoManager = session.getUndoManager();
+    undoManager.$doc = session;
+    undoManager.$undoStack = revive(state.undo);
+    undoManager.$redoStack = revive(state.redo);
+    undoManager.dirtyCounter = state.dirty;
+
+    setSelections(state.selections);
+    session.setScrollTop(state.scrollTop);
+    session.setScrollLeft(state.scrollLeft);
+}
+
+// Settings of the page, which Novile doesn't mirror itself, are kept while
+// it is torn down (see Editor::hibernate): text, markers and visual settings
+// are in C++, view state is kept by getViewState()
+function getSessionState() {
+    var session = editor.session;
+
+    return JSON.stringify({
+        options: {
+            readOnly: editor.getReadOnly(),
+            tabSize: session.getTabSize(),
+            useSoftTabs: session.getUseSoftTabs(),
+            useWrapMode: session.getUseWrapMode()
+        },
+        markerStyles: markerStyles,
+        providedFolds: providedFolds,
+        tokenizer: tokenizerConfig
+    });
+}
+
+// Counterpart of getSessionState(), view state is restored after it
+function restoreSessionState(json) {
+    var state = JSON.parse(json);
+    var session = editor.session;
+    var options = state.options;
+
+    editor.setReadOnly(options.readOnly);
+    session.setTabSize(options.tabSize);
+    session.setUseSoftTabs(options.useSoftTabs);
+    session.setUseWrapMode(options.useWrapMode);
+
+    for (var layer in state.markerStyles)
+        setMarkerStyle(layer, state.markerStyles[layer][0], state.markerStyles[layer][1]);
+
+    tokenizerConfig = state.tokenizer;
+    if (state.providedFolds) {
+        providedFolds = state.providedFolds;
+        applyFoldMode();
+    }
+}
@@ -133,9 +133,9 @@ void MainWindow::updateReadOnly(int checked)
 
 void MainWindow::updateDocument(int index)
 {
-    const QString documentText = documents[
+    const QString documentPath = documents[
             ui->selectDocument->itemText(index)];
-    editor->setText(documentText);
+    editor->loadFromFile(documentPath);
     editor->setCursorPosition(0, 0);
 }
 
@@ -189,13 +189,10 @@ void MainWindow::initExampleFiles()
 {
     QDir exampleDir(":/documents");
     QStringList exampleFiles = exampleDir.entryList(QDir::Files);
+    // Editor detects encoding of the document itself
     foreach(const QString &exampleFileName, exampleFiles) {
-        const QString filePath = exampleDir.absoluteFilePath(exampleFileName);
-        QFile example(filePath);
-        if (example.open(QIODevice::ReadOnly)) {
-            ui->selectDocument->addItem(exampleFileName);
-            documents[exampleFileName] = example.readAll();
-        }
+        ui->selectDocument->addItem(exampleFileName);
+        documents[exampleFileName] = exampleDir.absoluteFilePath(exampleFileName);
     }
 }
 
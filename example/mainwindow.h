@@ -45,7 +45,7 @@ public:
 private:
     Ui::MainWindow *ui;
     Novile::Editor *editor;
-    QMap<QString, QString> documents;
+    QMap<QString, QString> documents; // name -> path
 };
 
 #endif // MAINWINDOW_H
@@ -1,5 +1,5 @@
-QT = core gui webkit
-greaterThan(QT_MAJOR_VERSION, 4): QT += widgets webkitwidgets
+QT = core gui
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets concurrent
 TARGET = novile
 TEMPLATE = lib
 DESTDIR = ../lib
@@ -10,16 +10,56 @@ DEFINES += \
         NOVILE_MAKEDLL
 
 SOURCES = \
-	../src/editor.cpp
+	../src/editor.cpp \
+	../src/documentstore.cpp \
+	../src/textfile.cpp \
+	../src/folding.cpp \
+	../src/bracketindex.cpp \
+	../src/completionindex.cpp \
+	../src/documentsnapshot.cpp \
+	../src/editlog.cpp \
+	../src/diff.cpp \
+	../src/diffview.cpp \
+	../src/viewstate.cpp \
+	../src/editorsettings.cpp \
+	../src/textviewer.cpp
 
 HEADERS = \
     ../src/editor.h \
     ../src/novile_export.h \
+    ../src/novile_types.h \
+    ../src/documentsnapshot.h \
+    ../src/diffview.h \
+    ../src/editorsettings.h \
+    ../src/textviewer.h \
     ../src/novile_debug.h \
-    ../src/editor_p.h
+    ../src/editor_p.h \
+    ../src/documentstore_p.h \
+    ../src/textfile_p.h \
+    ../src/folding_p.h \
+    ../src/bracketindex_p.h \
+    ../src/completionindex_p.h \
+    ../src/editlog_p.h \
+    ../src/diff_p.h \
+    ../src/viewstate_p.h \
+    ../src/webbackend_p.h
+
+# Ace is hosted by QtWebKit, or by QtWebEngine with "CONFIG+=novile_webengine"
+novile_webengine {
+    QT += webenginewidgets webchannel
+    CONFIG += c++11
+    SOURCES += ../src/webenginebackend.cpp
+} else {
+    QT += webkit
+    greaterThan(QT_MAJOR_VERSION, 4): QT += webkitwidgets
+    SOURCES += ../src/webkitbackend.cpp
+}
 	
 RESOURCES = \
-	../data/shared.qrc
+	../data/shared.qrc \
+	../data/bundles.qrc
+
+QMAKE_RESOURCE_FLAGS += -compress 9 -threshold 5
 
 OTHER_FILES += \
     ../deploy/make_deb.py \
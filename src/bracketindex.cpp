@@ -0,0 +1,554 @@
+/*
+ * This file is part of the Novile Editor
+ * This program is free software licensed under the GNU LGPL. You can
+ * find a copy of this license in LICENSE in the top directory of
+ * the source code.
+ *
+ * Copyright 2013    Illya Kovalevskyy   <illya.kovalevskyy@gmail.com>
+ *
+ */
+
+#include "documentstore_p.h"
+#include "bracketindex_p.h"
+
+namespace Novile
+{
+
+BracketIndex::BracketIndex() :
+    m_root(-1),
+    m_seed(0x9e3779b9),
+    m_valid(false)
+{
+}
+
+void BracketIndex::invalidate()
+{
+    m_nodes.clear();
+    m_freeNodes.clear();
+    m_root = -1;
+    m_valid = false;
+}
+
+void BracketIndex::replaceLines(const DocumentStore &store, int row, int oldCount, int newCount)
+{
+    if (!m_valid)
+        return;
+
+    const int lines = lineCount();
+    if (row < 0 || row >= lines) {
+        invalidate();
+        return;
+    }
+
+    // Replaced lines are cut out of the tree, new ones are put in their place
+    oldCount = qMin(oldCount, lines - row);
+    int head, rest, replaced, tail;
+    split(m_root, row, &head, &rest);
+    split(rest, oldCount, &replaced, &tail);
+    freeTree(replaced);
+
+    const int inserted = build(store, row, newCount);
+    m_root = merge(merge(head, inserted), tail);
+
+    // Shouldn't happen, but index must never lie
+    if (lineCount() != store.lineCount())
+        invalidate();
+}
+
+bool BracketIndex::matching(const DocumentStore &store, int row, int column,
+                            int *matchRow, int *matchColumn)
+{
+    ensureReady(store);
+
+    const int index = bracketAt(row, column);
+    if (index < 0)
+        return false;
+
+    const ushort symbol = line(row).brackets.at(index).symbol;
+    const int before = depthBeforeLine(row) + prefix(line(row), index);
+
+    int foundRow, foundIndex;
+    const bool found = isOpening(symbol)
+            ? findForward(row, index, before, &foundRow, &foundIndex)
+            : findBackward(row, index, before - 1, &foundRow, &foundIndex);
+    if (!found)
+        return false;
+
+    const Bracket &match = line(foundRow).brackets.at(foundIndex);
+    if (match.symbol != counterpart(symbol))
+        return false;
+
+    *matchRow = foundRow;
+    *matchColumn = match.column;
+    return true;
+}
+
+bool BracketIndex::enclosing(const DocumentStore &store, int row, int column, Range *block)
+{
+    ensureReady(store);
+
+    if (row < 0 || row >= lineCount())
+        return false;
+
+    const int index = bracketsBefore(row, column);
+    const int depth = depthBeforeLine(row) + prefix(line(row), index);
+    if (depth <= 0)
+        return false;
+
+    int openRow, openIndex;
+    if (!findBackward(row, index, depth - 1, &openRow, &openIndex))
+        return false;
+
+    const Bracket &open = line(openRow).brackets.at(openIndex);
+    if (!isOpening(open.symbol))
+        return false;
+
+    int closeRow, closeIndex;
+    if (!findForward(openRow, openIndex, depth - 1, &closeRow, &closeIndex))
+        return false;
+
+    const Bracket &close = line(closeRow).brackets.at(closeIndex);
+    if (close.symbol != counterpart(open.symbol))
+        return false;
+
+    *block = Range(openRow, open.column, closeRow, close.column + 1);
+    return true;
+}
+
+int BracketIndex::depth(const DocumentStore &store, int row, int column)
+{
+    ensureReady(store);
+
+    if (row < 0 || row >= lineCount())
+        return 0;
+
+    return depthBeforeLine(row) + prefix(line(row), bracketsBefore(row, column));
+}
+
+BracketIndex::Line BracketIndex::scanLine(const QString &line)
+{
+    Line result;
+    const QChar *data = line.constData();
+    const int size = line.size();
+
+    int depth = 0;
+    ushort quote = 0;
+    for (int column = 0; column < size; ++column) {
+        const ushort c = data[column].unicode();
+
+        if (quote) {
+            if (c == '\\')
+                ++column;
+            else if (c == quote)
+                quote = 0;
+            continue;
+        }
+
+        if (c == '"' || c == '\'') {
+            quote = c;
+        } else if (counterpart(c)) {
+            const Bracket bracket = { column, c };
+            result.brackets << bracket;
+            result.minBefore = qMin(result.minBefore, depth);
+            depth += isOpening(c) ? 1 : -1;
+            result.minAfter = qMin(result.minAfter, depth);
+        }
+    }
+
+    result.delta = depth;
+    return result;
+}
+
+bool BracketIndex::isOpening(ushort symbol)
+{
+    return symbol == '{' || symbol == '[' || symbol == '(';
+}
+
+ushort BracketIndex::counterpart(ushort symbol)
+{
+    switch (symbol) {
+    case '{': return '}';
+    case '}': return '{';
+    case '[': return ']';
+    case ']': return '[';
+    case '(': return ')';
+    case ')': return '(';
+    default: return 0;
+    }
+}
+
+int BracketIndex::prefix(const Line &line, int count)
+{
+    int depth = 0;
+    for (int i = 0; i < count; ++i)
+        depth += isOpening(line.brackets.at(i).symbol) ? 1 : -1;
+    return depth;
+}
+
+BracketIndex::Summary BracketIndex::combine(const Summary &first, const Summary &second)
+{
+    Summary result;
+    result.sum = first.sum + second.sum;
+    result.minAfter = qMin(first.minAfter, first.sum + second.minAfter);
+    result.minBefore = second.minBefore == NoBrackets
+            ? first.minBefore
+            : qMin(first.minBefore, first.sum + second.minBefore);
+    return result;
+}
+
+void BracketIndex::ensureReady(const DocumentStore &store)
+{
+    if (m_valid)
+        return;
+
+    m_nodes.reserve(store.lineCount());
+    m_root = build(store, 0, store.lineCount());
+    m_valid = true;
+}
+
+int BracketIndex::lineCount() const
+{
+    return m_root < 0 ? 0 : m_nodes.at(m_root).count;
+}
+
+const BracketIndex::Line &BracketIndex::line(int row) const
+{
+    int node = m_root;
+    for (;;) {
+        const Node &current = m_nodes.at(node);
+        const int leftCount = current.left < 0 ? 0 : m_nodes.at(current.left).count;
+        if (row < leftCount) {
+            node = current.left;
+        } else if (row == leftCount) {
+            return current.line;
+        } else {
+            row -= leftCount + 1;
+            node = current.right;
+        }
+    }
+}
+
+int BracketIndex::build(const DocumentStore &store, int from, int count)
+{
+    // Cartesian tree of random priorities is a treap, and it's built in
+    // linear time: the stack keeps the right spine of the tree
+    QVector<int> spine;
+    for (int i = 0; i < count; ++i) {
+        const int node = newNode(scanLine(store.line(from + i)));
+
+        int last = -1;
+        while (!spine.isEmpty() && m_nodes.at(spine.last()).priority < m_nodes.at(node).priority) {
+            last = spine.last();
+            spine.removeLast();
+            updateNode(last);
+        }
+
+        m_nodes[node].left = last;
+        if (!spine.isEmpty())
+            m_nodes[spine.last()].right = node;
+        spine << node;
+    }
+
+    for (int i = spine.size() - 1; i >= 0; --i)
+        updateNode(spine.at(i));
+    return spine.isEmpty() ? -1 : spine.first();
+}
+
+int BracketIndex::newNode(const Line &line)
+{
+    int node;
+    if (m_freeNodes.isEmpty()) {
+        node = m_nodes.size();
+        m_nodes.append(Node());
+    } else {
+        node = m_freeNodes.last();
+        m_freeNodes.removeLast();
+    }
+
+    Node &created = m_nodes[node];
+    created.line = line;
+    created.left = -1;
+    created.right = -1;
+    created.priority = nextPriority();
+    updateNode(node);
+    return node;
+}
+
+void BracketIndex::freeTree(int node)
+{
+    QVector<int> pending;
+    if (node >= 0)
+        pending << node;
+
+    while (!pending.isEmpty()) {
+        const int current = pending.last();
+        pending.removeLast();
+
+        Node &freed = m_nodes[current];
+        if (freed.left >= 0)
+            pending << freed.left;
+        if (freed.right >= 0)
+            pending << freed.right;
+        freed.line = Line();
+        m_freeNodes << current;
+    }
+}
+
+void BracketIndex::updateNode(int node)
+{
+    Node &current = m_nodes[node];
+    const Summary own = { current.line.delta, current.line.minAfter, current.line.minBefore };
+
+    current.count = 1;
+    current.summary = own;
+    if (current.left >= 0) {
+        const Node &left = m_nodes.at(current.left);
+        current.count += left.count;
+        current.summary = combine(left.summary, current.summary);
+    }
+    if (current.right >= 0) {
+        const Node &right = m_nodes.at(current.right);
+        current.count += right.count;
+        current.summary = combine(current.summary, right.summary);
+    }
+}
+
+void BracketIndex::split(int node, int count, int *left, int *right)
+{
+    // The first count lines go to the left tree, the rest to the right one
+    if (node < 0) {
+        *left = -1;
+        *right = -1;
+        return;
+    }
+
+    const int leftChild = m_nodes.at(node).left;
+    const int leftCount = leftChild < 0 ? 0 : m_nodes.at(leftChild).count;
+    if (count <= leftCount) {
+        int rest;
+        split(leftChild, count, left, &rest);
+        m_nodes[node].left = rest;
+        *right = node;
+    } else {
+        int rest;
+        split(m_nodes.at(node).right, count - leftCount - 1, &rest, right);
+        m_nodes[node].right = rest;
+        *left = node;
+    }
+    updateNode(node);
+}
+
+int BracketIndex::merge(int left, int right)
+{
+    // All lines of the left tree go before the lines of the right one
+    if (left < 0)
+        return right;
+    if (right < 0)
+        return left;
+
+    if (m_nodes.at(left).priority > m_nodes.at(right).priority) {
+        const int merged = merge(m_nodes.at(left).right, right);
+        m_nodes[left].right = merged;
+        updateNode(left);
+        return left;
+    }
+
+    const int merged = merge(left, m_nodes.at(right).left);
+    m_nodes[right].left = merged;
+    updateNode(right);
+    return right;
+}
+
+uint BracketIndex::nextPriority()
+{
+    // xorshift: priorities only have to be random enough to balance the tree
+    m_seed ^= m_seed << 13;
+    m_seed ^= m_seed >> 17;
+    m_seed ^= m_seed << 5;
+    return m_seed;
+}
+
+int BracketIndex::depthBeforeLine(int row) const
+{
+    int depth = 0;
+    int node = m_root;
+    while (node >= 0) {
+        const Node &current = m_nodes.at(node);
+        const int leftCount = current.left < 0 ? 0 : m_nodes.at(current.left).count;
+        if (row < leftCount) {
+            node = current.left;
+            continue;
+        }
+
+        if (current.left >= 0)
+            depth += m_nodes.at(current.left).summary.sum;
+        if (row == leftCount)
+            break;
+
+        depth += current.line.delta;
+        row -= leftCount + 1;
+        node = current.right;
+    }
+    return depth;
+}
+
+int BracketIndex::bracketAt(int row, int column) const
+{
+    if (row < 0 || row >= lineCount())
+        return -1;
+
+    const int index = bracketsBefore(row, column);
+    const QVector<Bracket> &brackets = line(row).brackets;
+    return index < brackets.size() && brackets.at(index).column == column ? index : -1;
+}
+
+int BracketIndex::bracketsBefore(int row, int column) const
+{
+    // Brackets are sorted by column: binary search
+    const QVector<Bracket> &brackets = line(row).brackets;
+    int lo = 0;
+    int hi = brackets.size();
+    while (lo < hi) {
+        const int mid = (lo + hi) / 2;
+        if (brackets.at(mid).column < column)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+bool BracketIndex::findForward(int row, int index, int threshold,
+                               int *matchRow, int *matchIndex) const
+{
+    // The first bracket after the given one, where depth falls to the threshold
+    const QVector<Bracket> &brackets = line(row).brackets;
+    int depth = depthBeforeLine(row) + prefix(line(row), index + 1);
+    for (int i = index + 1; i < brackets.size(); ++i) {
+        depth += isOpening(brackets.at(i).symbol) ? 1 : -1;
+        if (depth <= threshold) {
+            *matchRow = row;
+            *matchIndex = i;
+            return true;
+        }
+    }
+
+    depth = depthBeforeLine(row + 1);
+    const int foundRow = searchForward(m_root, 0, row + 1, threshold, &depth);
+    if (foundRow < 0)
+        return false;
+
+    const QVector<Bracket> &candidates = line(foundRow).brackets;
+    for (int i = 0; i < candidates.size(); ++i) {
+        depth += isOpening(candidates.at(i).symbol) ? 1 : -1;
+        if (depth <= threshold) {
+            *matchRow = foundRow;
+            *matchIndex = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool BracketIndex::findBackward(int row, int index, int threshold,
+                                int *matchRow, int *matchIndex) const
+{
+    // The last bracket before the given one, where depth before it is
+    // the threshold (or less)
+    const QVector<Bracket> &brackets = line(row).brackets;
+    int depth = depthBeforeLine(row) + prefix(line(row), index);
+    for (int i = index - 1; i >= 0; --i) {
+        depth -= isOpening(brackets.at(i).symbol) ? 1 : -1;
+        if (depth <= threshold) {
+            *matchRow = row;
+            *matchIndex = i;
+            return true;
+        }
+    }
+
+    const int foundRow = searchBackward(m_root, 0, row, threshold, 0, &depth);
+    if (foundRow < 0)
+        return false;
+
+    const QVector<Bracket> &candidates = line(foundRow).brackets;
+    int last = -1;
+    for (int i = 0; i < candidates.size(); ++i) {
+        if (depth <= threshold)
+            last = i;
+        depth += isOpening(candidates.at(i).symbol) ? 1 : -1;
+    }
+
+    if (last < 0)
+        return false;
+
+    *matchRow = foundRow;
+    *matchIndex = last;
+    return true;
+}
+
+int BracketIndex::searchForward(int node, int offset, int from, int threshold,
+                                int *depth) const
+{
+    // The first line from @p from, where depth falls to the threshold;
+    // depth is accumulated up to the start of the found line, offset is
+    // the first line of the subtree
+    if (node < 0)
+        return -1;
+
+    const Node &current = m_nodes.at(node);
+    if (offset + current.count <= from)
+        return -1;
+
+    if (offset >= from && *depth + current.summary.minAfter > threshold) {
+        *depth += current.summary.sum;
+        return -1;
+    }
+
+    const int found = searchForward(current.left, offset, from, threshold, depth);
+    if (found >= 0)
+        return found;
+
+    const int row = offset + (current.left < 0 ? 0 : m_nodes.at(current.left).count);
+    if (row >= from) {
+        if (*depth + current.line.minAfter <= threshold)
+            return row;
+        *depth += current.line.delta;
+    }
+    return searchForward(current.right, row + 1, from, threshold, depth);
+}
+
+int BracketIndex::searchBackward(int node, int offset, int before, int threshold,
+                                 int start, int *depth) const
+{
+    // The last line before @p before with a bracket, where depth before it
+    // is the threshold or less; start is depth at the start of the subtree
+    if (node < 0 || offset >= before)
+        return -1;
+
+    const Node &current = m_nodes.at(node);
+    const int minBefore = current.summary.minBefore;
+    if (offset + current.count <= before &&
+            (minBefore == NoBrackets || start + minBefore > threshold))
+        return -1;
+
+    int row = offset;
+    int lineStart = start;
+    if (current.left >= 0) {
+        row += m_nodes.at(current.left).count;
+        lineStart += m_nodes.at(current.left).summary.sum;
+    }
+
+    const int found = searchBackward(current.right, row + 1, before, threshold,
+                                     lineStart + current.line.delta, depth);
+    if (found >= 0)
+        return found;
+
+    if (row < before && current.line.minBefore != NoBrackets &&
+            lineStart + current.line.minBefore <= threshold) {
+        *depth = lineStart;
+        return row;
+    }
+    return searchBackward(current.left, offset, before, threshold, start, depth);
+}
+
+} // namespace Novile
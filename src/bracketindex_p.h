@@ -0,0 +1,162 @@
+/*
+ * This file is part of the Novile Editor
+ * This program is free software licensed under the GNU LGPL. You can
+ * find a copy of this license in LICENSE in the top directory of
+ * the source code.
+ *
+ * Copyright 2013    Illya Kovalevskyy   <illya.kovalevskyy@gmail.com>
+ *
+ */
+
+#ifndef BRACKETINDEX_P_H
+#define BRACKETINDEX_P_H
+
+#include <QtCore/QVector>
+
+#include "novile_types.h"
+
+namespace Novile
+{
+
+class DocumentStore;
+
+/**
+ * @brief The BracketIndex class
+ *
+ * BracketIndex keeps positions of brackets ({}, [] and ()) for each line
+ * in a balanced tree over lines (treap, ordered by line number), and each
+ * subtree keeps depth change and minimal depths of its lines, so depth of
+ * any position and matching brackets are found in O(log n) lines. Brackets
+ * inside quoted strings are skipped.
+ *
+ * Index is built on the first query and then updated with changed lines
+ * only: replacing k lines with m others (e.g. Enter) costs O(m + log n)
+ * by splitting and merging the tree, nothing is rebuilt.
+ */
+class BracketIndex
+{
+public:
+    BracketIndex();
+
+    /**
+     * @brief Forget everything, index is rebuilt on the next query
+     */
+    void invalidate();
+
+    /**
+     * @brief Lines of the document have been replaced
+     * @param store document (already changed)
+     * @param row first changed line
+     * @param oldCount number of lines, which have been replaced
+     * @param newCount number of lines, which replaced them
+     */
+    void replaceLines(const DocumentStore &store, int row, int oldCount, int newCount);
+
+    /**
+     * @brief Find bracket, matching the one at the position
+     * @param store document
+     * @param row line of the bracket
+     * @param column position of the bracket in the line
+     * @param matchRow line of the matching bracket (output)
+     * @param matchColumn position of the matching bracket (output)
+     * @return is there a bracket with the match of the same kind?
+     */
+    bool matching(const DocumentStore &store, int row, int column,
+                  int *matchRow, int *matchColumn);
+
+    /**
+     * @brief Find the innermost pair of brackets around the position
+     * @param store document
+     * @param row coordinates: line
+     * @param column coordinates: position from the left
+     * @param block range from the opening bracket to the closing one (inclusive)
+     * @return is position inside any brackets?
+     */
+    bool enclosing(const DocumentStore &store, int row, int column, Range *block);
+
+    /**
+     * @brief Nesting depth (unclosed brackets) before the position
+     * @param store document
+     * @param row coordinates: line
+     * @param column coordinates: position from the left
+     * @return depth
+     */
+    int depth(const DocumentStore &store, int row, int column);
+
+private:
+    struct Bracket
+    {
+        int column;
+        ushort symbol;
+    };
+
+    struct Line
+    {
+        Line() : delta(0), minAfter(0), minBefore(NoBrackets) {}
+
+        QVector<Bracket> brackets;
+        int delta;      // depth change over the line
+        int minAfter;   // minimal depth after a bracket, relative to line start
+        int minBefore;  // minimal depth before a bracket, relative to line start
+    };
+
+    // Depth change and minimal depths of consecutive lines
+    struct Summary
+    {
+        int sum;
+        int minAfter;
+        int minBefore;
+    };
+
+    // Node of the treap: line and summary of its subtree
+    struct Node
+    {
+        Line line;
+        Summary summary;
+        int count;      // lines in the subtree
+        int left;
+        int right;
+        uint priority;
+    };
+
+    enum { NoBrackets = 0x3fffffff };
+
+    static Line scanLine(const QString &line);
+    static bool isOpening(ushort symbol);
+    static ushort counterpart(ushort symbol);
+    static int prefix(const Line &line, int count);
+    static Summary combine(const Summary &first, const Summary &second);
+
+    void ensureReady(const DocumentStore &store);
+    int lineCount() const;
+    const Line &line(int row) const;
+
+    int build(const DocumentStore &store, int from, int count);
+    int newNode(const Line &line);
+    void freeTree(int node);
+    void updateNode(int node);
+    void split(int node, int count, int *left, int *right);
+    int merge(int left, int right);
+    uint nextPriority();
+
+    int depthBeforeLine(int row) const;
+    int bracketAt(int row, int column) const;
+    int bracketsBefore(int row, int column) const;
+
+    bool findForward(int row, int index, int threshold, int *matchRow, int *matchIndex) const;
+    bool findBackward(int row, int index, int threshold, int *matchRow, int *matchIndex) const;
+
+    int searchForward(int node, int offset, int from, int threshold, int *depth) const;
+    int searchBackward(int node, int offset, int before, int threshold,
+                       int start, int *depth) const;
+
+    QVector<Node> m_nodes;
+    QVector<int> m_freeNodes;
+    int m_root;
+    uint m_seed;
+    bool m_valid;
+};
+
+} // namespace Novile
+
+#endif // BRACKETINDEX_P_H
@@ -0,0 +1,89 @@
+/*
+ * This file is part of the Novile Editor
+ * This program is free software licensed under the GNU LGPL. You can
+ * find a copy of this license in LICENSE in the top directory of
+ * the source code.
+ *
+ * Copyright 2013    Illya Kovalevskyy   <illya.kovalevskyy@gmail.com>
+ *
+ */
+
+#include "completionindex_p.h"
+
+namespace Novile
+{
+
+Q_GLOBAL_STATIC(CompletionIndex, globalIndex)
+
+// Shorter words aren't worth completing
+static const int MinimumWordLength = 2;
+
+static inline bool isWordChar(QChar c)
+{
+    return c.isLetterOrNumber() || c == QLatin1Char('_') || c == QLatin1Char('$');
+}
+
+CompletionIndex *CompletionIndex::instance()
+{
+    return globalIndex();
+}
+
+void CompletionIndex::update(const WordCounts &words)
+{
+    WordCounts::const_iterator i = words.constBegin();
+    for (; i != words.constEnd(); ++i) {
+        if (!i.value())
+            continue;
+
+        QMap<QString, int>::iterator word = m_words.find(i.key());
+        if (word == m_words.end()) {
+            if (i.value() > 0)
+                m_words.insert(i.key(), i.value());
+        } else if ((word.value() += i.value()) <= 0) {
+            m_words.erase(word);
+        }
+    }
+}
+
+QStringList CompletionIndex::complete(const QString &prefix, int limit) const
+{
+    QStringList result;
+    QMap<QString, int>::const_iterator i = m_words.lowerBound(prefix);
+    for (; i != m_words.constEnd() && result.size() < limit; ++i) {
+        if (!i.key().startsWith(prefix))
+            break;
+        if (i.key().size() > prefix.size())
+            result << i.key();
+    }
+    return result;
+}
+
+void CompletionIndex::countWords(const QString &line, int sign, WordCounts *words)
+{
+    const QChar *data = line.constData();
+    const int size = line.size();
+
+    int i = 0;
+    while (i < size) {
+        if (!isWordChar(data[i])) {
+            ++i;
+            continue;
+        }
+
+        const int start = i;
+        while (i < size && isWordChar(data[i]))
+            ++i;
+
+        // Numbers are not identifiers
+        if (i - start >= MinimumWordLength && !data[start].isDigit())
+            (*words)[line.mid(start, i - start)] += sign;
+    }
+}
+
+void CompletionIndex::countWords(const QStringList &lines, int sign, WordCounts *words)
+{
+    foreach (const QString &line, lines)
+        countWords(line, sign, words);
+}
+
+} // namespace Novile
@@ -0,0 +1,78 @@
+/*
+ * This file is part of the Novile Editor
+ * This program is free software licensed under the GNU LGPL. You can
+ * find a copy of this license in LICENSE in the top directory of
+ * the source code.
+ *
+ * Copyright 2013    Illya Kovalevskyy   <illya.kovalevskyy@gmail.com>
+ *
+ */
+
+#ifndef COMPLETIONINDEX_P_H
+#define COMPLETIONINDEX_P_H
+
+#include <QtCore/QHash>
+#include <QtCore/QMap>
+#include <QtCore/QStringList>
+
+namespace Novile
+{
+
+/**
+ * @brief Number of occurrences of each word (may be negative for changes)
+ */
+typedef QHash<QString, int> WordCounts;
+
+/**
+ * @brief The CompletionIndex class
+ *
+ * Sorted index of identifiers from all open documents. Editors push
+ * differences of their words only (per changed line), so completion is a
+ * binary search for the prefix plus walking at most @c limit entries.
+ * Used from the GUI thread only.
+ */
+class CompletionIndex
+{
+public:
+    /**
+     * @brief Index, shared by all editors
+     */
+    static CompletionIndex *instance();
+
+    /**
+     * @brief Add (or remove, if counts are negative) words
+     * @param words difference of word counts
+     */
+    void update(const WordCounts &words);
+
+    /**
+     * @brief Words, which start with the @p prefix (but not the prefix itself)
+     * @param prefix beginning of the word
+     * @param limit maximal number of words
+     * @return words in alphabetical order
+     */
+    QStringList complete(const QString &prefix, int limit) const;
+
+    /**
+     * @brief Count identifiers of the line (thread-safe)
+     * @param line line of the document
+     * @param sign 1 to add occurrences or -1 to subtract them
+     * @param words counts to update
+     */
+    static void countWords(const QString &line, int sign, WordCounts *words);
+
+    /**
+     * @brief Count identifiers of the lines (thread-safe)
+     * @param lines lines of the document
+     * @param sign 1 to add occurrences or -1 to subtract them
+     * @param words counts to update
+     */
+    static void countWords(const QStringList &lines, int sign, WordCounts *words);
+
+private:
+    QMap<QString, int> m_words;
+};
+
+} // namespace Novile
+
+#endif // COMPLETIONINDEX_P_H
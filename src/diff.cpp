@@ -0,0 +1,275 @@
+/*
+ * This file is part of the Novile Editor
+ * This program is free software licensed under the GNU LGPL. You can
+ * find a copy of this license in LICENSE in the top directory of
+ * the source code.
+ *
+ * Copyright 2013    Illya Kovalevskyy   <illya.kovalevskyy@gmail.com>
+ *
+ */
+
+#include <QtCore/QSet>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include "diff_p.h"
+
+namespace Novile
+{
+
+namespace Diff
+{
+
+// Smaller documents are hashed faster than threads are started
+static const int ParallelHashing = 8192;
+
+static uint hashLine(const QString &line)
+{
+    return qHash(line);
+}
+
+static QVector<uint> hashLines(const QStringList &lines)
+{
+    if (lines.size() >= ParallelHashing)
+        return QtConcurrent::blockingMapped<QVector<uint> >(lines, hashLine);
+
+    QVector<uint> hashes;
+    hashes.reserve(lines.size());
+    foreach (const QString &line, lines)
+        hashes << hashLine(line);
+    return hashes;
+}
+
+/**
+ * @brief Myers comparison of the lines, which can match
+ *
+ * Lines are addressed by positions in the compacted sequences, which are
+ * mapped to rows of the documents to mark removed and added ones
+ */
+class Comparison
+{
+public:
+    Comparison(const QStringList &oldLines, const QStringList &newLines,
+               QVector<bool> *removed, QVector<bool> *added) :
+        m_old(oldLines), m_new(newLines), m_removed(*removed), m_added(*added)
+    {
+    }
+
+    void addOld(int row, uint hash)
+    {
+        m_oldRows << row;
+        m_oldHashes << hash;
+    }
+
+    void addNew(int row, uint hash)
+    {
+        m_newRows << row;
+        m_newHashes << hash;
+    }
+
+    void run()
+    {
+        compare(0, m_oldRows.size(), 0, m_newRows.size());
+    }
+
+private:
+    bool equal(int x, int y) const
+    {
+        return m_oldHashes.at(x) == m_newHashes.at(y) &&
+               m_old.at(m_oldRows.at(x)) == m_new.at(m_newRows.at(y));
+    }
+
+    void compare(int oldLo, int oldHi, int newLo, int newHi)
+    {
+        while (oldLo < oldHi && newLo < newHi && equal(oldLo, newLo)) {
+            ++oldLo;
+            ++newLo;
+        }
+        while (oldLo < oldHi && newLo < newHi && equal(oldHi - 1, newHi - 1)) {
+            --oldHi;
+            --newHi;
+        }
+
+        if (oldLo == oldHi || newLo == newHi) {
+            for (int x = oldLo; x < oldHi; ++x)
+                m_removed[m_oldRows.at(x)] = true;
+            for (int y = newLo; y < newHi; ++y)
+                m_added[m_newRows.at(y)] = true;
+            return;
+        }
+
+        int x, y;
+        if (bisect(oldLo, oldHi, newLo, newHi, &x, &y)) {
+            compare(oldLo, x, newLo, y);
+            compare(x, oldHi, y, newHi);
+        } else {
+            compare(oldLo, oldHi, newHi, newHi);
+            compare(oldHi, oldHi, newLo, newHi);
+        }
+    }
+
+    // Find the middle snake: forward and backward paths meet there
+    bool bisect(int oldLo, int oldHi, int newLo, int newHi, int *splitX, int *splitY)
+    {
+        const int n = oldHi - oldLo;
+        const int m = newHi - newLo;
+        const int maxD = (n + m + 1) / 2;
+        const int offset = maxD;
+        const int length = 2 * maxD + 2;
+        const int delta = n - m;
+        const bool front = delta % 2 != 0;
+
+        QVector<int> forward(length, -1);
+        QVector<int> backward(length, -1);
+        forward[offset + 1] = 0;
+        backward[offset + 1] = 0;
+
+        int k1start = 0, k1end = 0, k2start = 0, k2end = 0;
+        for (int d = 0; d < maxD; ++d) {
+            for (int k1 = -d + k1start; k1 <= d - k1end; k1 += 2) {
+                const int k1offset = offset + k1;
+                int x1;
+                if (k1 == -d || (k1 != d && forward.at(k1offset - 1) < forward.at(k1offset + 1)))
+                    x1 = forward.at(k1offset + 1);
+                else
+                    x1 = forward.at(k1offset - 1) + 1;
+                int y1 = x1 - k1;
+                while (x1 < n && y1 < m && equal(oldLo + x1, newLo + y1)) {
+                    ++x1;
+                    ++y1;
+                }
+                forward[k1offset] = x1;
+
+                if (x1 > n) {
+                    k1end += 2;
+                } else if (y1 > m) {
+                    k1start += 2;
+                } else if (front) {
+                    const int k2offset = offset + delta - k1;
+                    if (k2offset >= 0 && k2offset < length && backward.at(k2offset) != -1 &&
+                            x1 >= n - backward.at(k2offset)) {
+                        *splitX = oldLo + x1;
+                        *splitY = newLo + y1;
+                        return true;
+                    }
+                }
+            }
+
+            for (int k2 = -d + k2start; k2 <= d - k2end; k2 += 2) {
+                const int k2offset = offset + k2;
+                int x2;
+                if (k2 == -d || (k2 != d && backward.at(k2offset - 1) < backward.at(k2offset + 1)))
+                    x2 = backward.at(k2offset + 1);
+                else
+                    x2 = backward.at(k2offset - 1) + 1;
+                int y2 = x2 - k2;
+                while (x2 < n && y2 < m && equal(oldHi - x2 - 1, newHi - y2 - 1)) {
+                    ++x2;
+                    ++y2;
+                }
+                backward[k2offset] = x2;
+
+                if (x2 > n) {
+                    k2end += 2;
+                } else if (y2 > m) {
+                    k2start += 2;
+                } else if (!front) {
+                    const int k1offset = offset + delta - k2;
+                    if (k1offset >= 0 && k1offset < length && forward.at(k1offset) != -1) {
+                        const int x1 = forward.at(k1offset);
+                        if (x1 >= n - x2) {
+                            *splitX = oldLo + x1;
+                            *splitY = newLo + x1 - (k1offset - offset);
+                            return true;
+                        }
+                    }
+                }
+            }
+        }
+
+        // Nothing in common
+        return false;
+    }
+
+    const QStringList &m_old;
+    const QStringList &m_new;
+    QVector<bool> &m_removed;
+    QVector<bool> &m_added;
+
+    QVector<int> m_oldRows;
+    QVector<uint> m_oldHashes;
+    QVector<int> m_newRows;
+    QVector<uint> m_newHashes;
+};
+
+QVector<DiffHunk> compute(const QStringList &oldLines, const QStringList &newLines)
+{
+    const QVector<uint> oldHashes = hashLines(oldLines);
+    const QVector<uint> newHashes = hashLines(newLines);
+
+    // Common prefix and suffix
+    int oldLo = 0, newLo = 0;
+    int oldHi = oldLines.size(), newHi = newLines.size();
+    while (oldLo < oldHi && newLo < newHi && oldHashes.at(oldLo) == newHashes.at(newLo) &&
+           oldLines.at(oldLo) == newLines.at(newLo)) {
+        ++oldLo;
+        ++newLo;
+    }
+    while (oldLo < oldHi && newLo < newHi && oldHashes.at(oldHi - 1) == newHashes.at(newHi - 1) &&
+           oldLines.at(oldHi - 1) == newLines.at(newHi - 1)) {
+        --oldHi;
+        --newHi;
+    }
+
+    QVector<bool> removed(oldLines.size(), false);
+    QVector<bool> added(newLines.size(), false);
+
+    // Line, which hash isn't met in the other document, is changed for sure
+    QSet<uint> oldSet, newSet;
+    oldSet.reserve(oldHi - oldLo);
+    newSet.reserve(newHi - newLo);
+    for (int row = oldLo; row < oldHi; ++row)
+        oldSet.insert(oldHashes.at(row));
+    for (int row = newLo; row < newHi; ++row)
+        newSet.insert(newHashes.at(row));
+
+    Comparison comparison(oldLines, newLines, &removed, &added);
+    for (int row = oldLo; row < oldHi; ++row) {
+        if (newSet.contains(oldHashes.at(row)))
+            comparison.addOld(row, oldHashes.at(row));
+        else
+            removed[row] = true;
+    }
+    for (int row = newLo; row < newHi; ++row) {
+        if (oldSet.contains(newHashes.at(row)))
+            comparison.addNew(row, newHashes.at(row));
+        else
+            added[row] = true;
+    }
+    comparison.run();
+
+    // Unchanged lines go in the same order in both documents
+    QVector<DiffHunk> hunks;
+    int oldRow = 0, newRow = 0;
+    while (oldRow < oldLines.size() || newRow < newLines.size()) {
+        if (oldRow < oldLines.size() && newRow < newLines.size() &&
+                !removed.at(oldRow) && !added.at(newRow)) {
+            ++oldRow;
+            ++newRow;
+            continue;
+        }
+
+        const int oldStart = oldRow;
+        const int newStart = newRow;
+        while (oldRow < oldLines.size() && removed.at(oldRow))
+            ++oldRow;
+        while (newRow < newLines.size() && added.at(newRow))
+            ++newRow;
+
+        hunks << DiffHunk(oldStart, oldRow - oldStart, newStart, newRow - newStart);
+    }
+    return hunks;
+}
+
+} // namespace Diff
+
+} // namespace Novile
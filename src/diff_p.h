@@ -0,0 +1,45 @@
+/*
+ * This file is part of the Novile Editor
+ * This program is free software licensed under the GNU LGPL. You can
+ * find a copy of this license in LICENSE in the top directory of
+ * the source code.
+ *
+ * Copyright 2013    Illya Kovalevskyy   <illya.kovalevskyy@gmail.com>
+ *
+ */
+
+#ifndef DIFF_P_H
+#define DIFF_P_H
+
+#include <QtCore/QStringList>
+#include <QtCore/QVector>
+
+#include "novile_types.h"
+
+namespace Novile
+{
+
+/**
+ * @brief Line diff engine
+ *
+ * Lines are hashed in parallel and compared by hash first. Common
+ * prefix and suffix are trimmed, lines, which don't occur in the other
+ * document at all, are excluded (they can't match anything), and the
+ * rest is compared with linear space Myers algorithm.
+ */
+namespace Diff
+{
+
+/**
+ * @brief Compute difference of two documents (thread-safe)
+ * @param oldLines lines of the old document
+ * @param newLines lines of the new document
+ * @return hunks, sorted by position
+ */
+QVector<DiffHunk> compute(const QStringList &oldLines, const QStringList &newLines);
+
+} // namespace Diff
+
+} // namespace Novile
+
+#endif // DIFF_P_H
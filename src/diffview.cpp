@@ -0,0 +1,220 @@
+/*
+ * This file is part of the Novile Editor
+ * This program is free software licensed under the GNU LGPL. You can
+ * find a copy of this license in LICENSE in the top directory of
+ * the source code.
+ *
+ * Copyright 2013    Illya Kovalevskyy   <illya.kovalevskyy@gmail.com>
+ *
+ */
+
+#include <QtCore>
+#include <QtConcurrent>
+
+#include "editor.h"
+#include "diffview.h"
+#include "diff_p.h"
+
+namespace Novile
+{
+
+static const char *RemovedLayer = "diff_removed";
+static const char *AddedLayer = "diff_added";
+
+class DiffViewPrivate
+{
+public:
+    DiffViewPrivate(Editor *oldEditor, Editor *newEditor) :
+        oldEditor(oldEditor),
+        newEditor(newEditor),
+        expectedOld(-1),
+        expectedNew(-1)
+    {
+    }
+
+    /**
+     * @brief Scroll the editor, remembering the line, which it reports back
+     *
+     * Editor reports scrolling later with the QtWebEngine backend, so a
+     * flag around the call can't tell our scrolling from the user's one
+     * @param editor editor to scroll
+     * @param row new first visible line
+     * @param expected line, reported by the editor (output)
+     */
+    static void scroll(Editor *editor, int row, int *expected)
+    {
+        if (!editor || editor->firstVisibleLine() == row)
+            return;
+
+        *expected = row;
+        editor->setFirstVisibleLine(row);
+    }
+
+    /**
+     * @brief Is the reported line an echo of scroll()?
+     * @param row reported line
+     * @param expected line, remembered by scroll() (reset, if it matches)
+     * @return is it?
+     */
+    static bool isEcho(int row, int *expected)
+    {
+        if (row != *expected)
+            return false;
+
+        *expected = -1;
+        return true;
+    }
+
+    /**
+     * @brief Map line through hunks from one document to the other
+     * @param row line of the source document
+     * @param fromOld is source document the old one?
+     * @return line of the other document
+     */
+    int mapRow(int row, bool fromOld) const
+    {
+        // Last hunk, which starts at the row or before it
+        int lo = 0;
+        int hi = hunks.size();
+        while (lo < hi) {
+            const int mid = (lo + hi) / 2;
+            const DiffHunk &hunk = hunks.at(mid);
+            if ((fromOld ? hunk.oldStart : hunk.newStart) <= row)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+
+        if (lo == 0)
+            return row;
+
+        const DiffHunk &hunk = hunks.at(lo - 1);
+        const int start = fromOld ? hunk.oldStart : hunk.newStart;
+        const int count = fromOld ? hunk.oldCount : hunk.newCount;
+        const int otherStart = fromOld ? hunk.newStart : hunk.oldStart;
+        const int otherCount = fromOld ? hunk.newCount : hunk.oldCount;
+
+        // Inside of the hunk: stick to its lines on the other side
+        if (row < start + count)
+            return otherStart + qMin(row - start, qMax(otherCount - 1, 0));
+        return otherStart + otherCount + (row - start - count);
+    }
+
+    QPointer<Editor> oldEditor;
+    QPointer<Editor> newEditor;
+    QFutureWatcher<QVector<DiffHunk> > watcher;
+    QVector<DiffHunk> hunks;
+
+    // Lines, which editors will report after they are scrolled by us
+    int expectedOld;
+    int expectedNew;
+};
+
+DiffView::DiffView(Editor *oldEditor, Editor *newEditor, QObject *parent) :
+    QObject(parent),
+    d(new DiffViewPrivate(oldEditor, newEditor))
+{
+    oldEditor->setMarkerStyle(RemovedLayer, "background: rgba(255, 0, 0, 0.15);",
+                              Editor::MarkerFullLine);
+    newEditor->setMarkerStyle(AddedLayer, "background: rgba(0, 200, 0, 0.15);",
+                              Editor::MarkerFullLine);
+
+    connect(&d->watcher, SIGNAL(finished()), SLOT(onHunksComputed()));
+
+    connect(oldEditor, SIGNAL(textChanged()), SLOT(update()));
+    connect(newEditor, SIGNAL(textChanged()), SLOT(update()));
+
+    connect(oldEditor, SIGNAL(firstVisibleLineChanged(int)), SLOT(onOldScrolled(int)));
+    connect(newEditor, SIGNAL(firstVisibleLineChanged(int)), SLOT(onNewScrolled(int)));
+
+    update();
+}
+
+DiffView::~DiffView()
+{
+    clear();
+    d->watcher.waitForFinished();
+    delete d;
+}
+
+QVector<DiffHunk> DiffView::compute(const QStringList &oldLines, const QStringList &newLines)
+{
+    return Diff::compute(oldLines, newLines);
+}
+
+QFuture<QVector<DiffHunk> > DiffView::computeAsync(const DocumentSnapshot &oldDocument,
+                                                   const DocumentSnapshot &newDocument)
+{
+    return QtConcurrent::run(Diff::compute, oldDocument.lines(), newDocument.lines());
+}
+
+QVector<DiffHunk> DiffView::hunks() const
+{
+    return d->hunks;
+}
+
+int DiffView::mapToNew(int row) const
+{
+    return d->mapRow(row, true);
+}
+
+int DiffView::mapToOld(int row) const
+{
+    return d->mapRow(row, false);
+}
+
+void DiffView::update()
+{
+    if (!d->oldEditor || !d->newEditor)
+        return;
+
+    // Result of the previous run (if any) is not reported anymore
+    d->watcher.setFuture(computeAsync(d->oldEditor->snapshot(), d->newEditor->snapshot()));
+}
+
+void DiffView::clear()
+{
+    d->hunks.clear();
+    if (d->oldEditor)
+        d->oldEditor->clearMarkers(RemovedLayer);
+    if (d->newEditor)
+        d->newEditor->clearMarkers(AddedLayer);
+}
+
+void DiffView::onHunksComputed()
+{
+    d->hunks = d->watcher.result();
+
+    QVector<Range> removed, added;
+    foreach (const DiffHunk &hunk, d->hunks) {
+        if (hunk.oldCount)
+            removed << Range(hunk.oldStart, 0, hunk.oldStart + hunk.oldCount - 1, 0);
+        if (hunk.newCount)
+            added << Range(hunk.newStart, 0, hunk.newStart + hunk.newCount - 1, 0);
+    }
+
+    if (d->oldEditor)
+        d->oldEditor->setMarkers(RemovedLayer, removed);
+    if (d->newEditor)
+        d->newEditor->setMarkers(AddedLayer, added);
+
+    emit updated();
+}
+
+void DiffView::onOldScrolled(int row)
+{
+    if (DiffViewPrivate::isEcho(row, &d->expectedOld))
+        return;
+
+    DiffViewPrivate::scroll(d->newEditor, mapToNew(row), &d->expectedNew);
+}
+
+void DiffView::onNewScrolled(int row)
+{
+    if (DiffViewPrivate::isEcho(row, &d->expectedNew))
+        return;
+
+    DiffViewPrivate::scroll(d->oldEditor, mapToOld(row), &d->expectedOld);
+}
+
+} // namespace Novile
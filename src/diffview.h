@@ -0,0 +1,121 @@
+/*
+ * This file is part of the Novile Editor
+ * This program is free software licensed under the GNU LGPL. You can
+ * find a copy of this license in LICENSE in the top directory of
+ * the source code.
+ *
+ * Copyright 2013    Illya Kovalevskyy   <illya.kovalevskyy@gmail.com>
+ *
+ */
+
+#ifndef DIFFVIEW_H
+#define DIFFVIEW_H
+
+#include <QObject>
+#include <QStringList>
+#include <QVector>
+#include <QFuture>
+#include "novile_export.h"
+#include "novile_types.h"
+#include "documentsnapshot.h"
+
+namespace Novile
+{
+
+class Editor;
+class DiffViewPrivate;
+
+/**
+ * @brief The DiffView class
+ *
+ * DiffView links two editors, old and new versions of a document:
+ * changed lines are painted as full line markers ("diff_removed" layer in
+ * the old editor, "diff_added" in the new one) and scrolling of one
+ * editor scrolls the other one to the corresponding line.
+ *
+ * Difference is computed in the background by a line diff (Myers
+ * algorithm on line hashes) and updated, when text of any editor changes.
+ */
+class NOVILE_EXPORT DiffView : public QObject
+{
+    Q_OBJECT
+public:
+    /**
+     * @brief Link two editors
+     * @param oldEditor editor with the old version
+     * @param newEditor editor with the new version
+     * @param parent QObject parent
+     */
+    DiffView(Editor *oldEditor, Editor *newEditor, QObject *parent = 0);
+
+    /**
+     * @brief Markers are removed from the editors
+     */
+    ~DiffView();
+
+    /**
+     * @brief Compute difference of two documents (thread-safe)
+     * @param oldLines lines of the old document
+     * @param newLines lines of the new document
+     * @return hunks of changed lines, sorted by position
+     */
+    static QVector<DiffHunk> compute(const QStringList &oldLines, const QStringList &newLines);
+
+    /**
+     * @brief Compute difference of two document snapshots in the background
+     * @param oldDocument old document
+     * @param newDocument new document
+     * @return future with hunks
+     */
+    static QFuture<QVector<DiffHunk> > computeAsync(const DocumentSnapshot &oldDocument,
+                                                    const DocumentSnapshot &newDocument);
+
+    /**
+     * @brief Hunks, which are painted now
+     * @return hunks of changed lines, sorted by position
+     */
+    QVector<DiffHunk> hunks() const;
+
+    /**
+     * @brief Line of the new document, which corresponds to the old one
+     * @param row line of the old document
+     * @return line of the new document
+     */
+    int mapToNew(int row) const;
+
+    /**
+     * @brief Line of the old document, which corresponds to the new one
+     * @param row line of the new document
+     * @return line of the old document
+     */
+    int mapToOld(int row) const;
+
+public slots:
+    /**
+     * @brief Recompute difference and repaint it, when it's ready
+     */
+    void update();
+
+    /**
+     * @brief Remove diff markers from both editors
+     */
+    void clear();
+
+signals:
+    /**
+     * @brief New hunks have been painted
+     */
+    void updated();
+
+private slots:
+    void onHunksComputed();
+    void onOldScrolled(int row);
+    void onNewScrolled(int row);
+
+private:
+    DiffViewPrivate * const d;
+};
+
+} // namespace Novile
+
+#endif // DIFFVIEW_H
@@ -0,0 +1,54 @@
+/*
+ * This file is part of the Novile Editor
+ * This program is free software licensed under the GNU LGPL. You can
+ * find a copy of this license in LICENSE in the top directory of
+ * the source code.
+ *
+ * Copyright 2013    Illya Kovalevskyy   <illya.kovalevskyy@gmail.com>
+ *
+ */
+
+#include "documentsnapshot.h"
+
+namespace Novile
+{
+
+DocumentSnapshot::DocumentSnapshot() :
+    m_newLine("\n"),
+    m_version(0)
+{
+}
+
+DocumentSnapshot::DocumentSnapshot(const QStringList &lines, const QString &newLine, int version) :
+    m_lines(lines),
+    m_newLine(newLine),
+    m_version(version)
+{
+}
+
+int DocumentSnapshot::version() const
+{
+    return m_version;
+}
+
+int DocumentSnapshot::lineCount() const
+{
+    return m_lines.size();
+}
+
+QString DocumentSnapshot::line(int row) const
+{
+    return m_lines.value(row);
+}
+
+QStringList DocumentSnapshot::lines() const
+{
+    return m_lines;
+}
+
+QString DocumentSnapshot::text() const
+{
+    return m_lines.join(m_newLine);
+}
+
+} // namespace Novile
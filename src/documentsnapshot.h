@@ -0,0 +1,86 @@
+/*
+ * This file is part of the Novile Editor
+ * This program is free software licensed under the GNU LGPL. You can
+ * find a copy of this license in LICENSE in the top directory of
+ * the source code.
+ *
+ * Copyright 2013    Illya Kovalevskyy   <illya.kovalevskyy@gmail.com>
+ *
+ */
+
+#ifndef DOCUMENTSNAPSHOT_H
+#define DOCUMENTSNAPSHOT_H
+
+#include <QtCore/QStringList>
+#include <QtCore/QMetaType>
+#include "novile_export.h"
+
+namespace Novile
+{
+
+class Editor;
+
+/**
+ * @brief The DocumentSnapshot class
+ *
+ * Immutable state of the document at some version. Lines are implicitly
+ * shared with the editor, so taking and copying a snapshot costs nothing,
+ * and it's safe to read it from any thread while the document is edited.
+ * @see Editor::snapshot()
+ */
+class NOVILE_EXPORT DocumentSnapshot
+{
+public:
+    /**
+     * @brief Empty snapshot (no lines, version 0)
+     */
+    DocumentSnapshot();
+
+    /**
+     * @brief Version of the document, snapshot was taken at
+     *
+     * Version is increased by every change of the document, so equal
+     * versions of the same editor mean equal text
+     * @return version
+     */
+    int version() const;
+
+    /**
+     * @brief Number of lines
+     * @return number
+     */
+    int lineCount() const;
+
+    /**
+     * @brief Line of the document (without line ending)
+     * @param row number of the line
+     * @return line or empty string, if there is no such line
+     */
+    QString line(int row) const;
+
+    /**
+     * @brief All lines of the document
+     * @return lines
+     */
+    QStringList lines() const;
+
+    /**
+     * @brief Whole text with line endings of the document
+     * @return text
+     */
+    QString text() const;
+
+private:
+    friend class Editor;
+    DocumentSnapshot(const QStringList &lines, const QString &newLine, int version);
+
+    QStringList m_lines;
+    QString m_newLine;
+    int m_version;
+};
+
+} // namespace Novile
+
+Q_DECLARE_METATYPE(Novile::DocumentSnapshot)
+
+#endif // DOCUMENTSNAPSHOT_H
@@ -0,0 +1,197 @@
+/*
+ * This file is part of the Novile Editor
+ * This program is free software licensed under the GNU LGPL. You can
+ * find a copy of this license in LICENSE in the top directory of
+ * the source code.
+ *
+ * Copyright 2013    Illya Kovalevskyy   <illya.kovalevskyy@gmail.com>
+ *
+ */
+
+#include "documentstore_p.h"
+
+namespace Novile
+{
+
+DocumentStore::DocumentStore() :
+    m_lines(QString()),
+    m_characters(0),
+    m_version(0),
+    m_lineEnding(Editor::LineEndingUnix)
+{
+}
+
+void DocumentStore::setText(const QString &text)
+{
+    m_lines = splitLines(text, &m_lineEnding);
+    m_characters = countCharacters(m_lines, 0, m_lines.size());
+    m_version++;
+}
+
+void DocumentStore::setLines(const QStringList &lines, Editor::LineEnding lineEnding)
+{
+    m_lines = lines.isEmpty() ? QStringList(QString()) : lines;
+    m_characters = countCharacters(m_lines, 0, m_lines.size());
+    m_lineEnding = lineEnding;
+    m_version++;
+}
+
+QString DocumentStore::text() const
+{
+    return m_lines.join(newLine(m_lineEnding));
+}
+
+Editor::LineEnding DocumentStore::lineEnding() const
+{
+    return m_lineEnding;
+}
+
+void DocumentStore::setLineEnding(Editor::LineEnding lineEnding)
+{
+    m_lineEnding = lineEnding;
+}
+
+QString DocumentStore::newLine(Editor::LineEnding lineEnding)
+{
+    switch (lineEnding) {
+    case Editor::LineEndingWindows:
+        return QString("\r\n");
+    case Editor::LineEndingMac:
+        return QString("\r");
+    default:
+        return QString("\n");
+    }
+}
+
+void DocumentStore::insert(int row, int column, const QString &text)
+{
+    if (text.isEmpty())
+        return;
+
+    row = qBound(0, row, m_lines.size() - 1);
+    const QStringList inserted = splitLines(text);
+
+    const QString &current = m_lines.at(row);
+    column = qBound(0, column, current.length());
+
+    if (inserted.size() == 1) {
+        m_lines[row].insert(column, inserted.first());
+    } else {
+        // Lines are spliced in one pass: inserting them one by one would
+        // shift the tail of the document for each of them
+        QStringList spliced;
+        spliced.reserve(m_lines.size() + inserted.size() - 1);
+        for (int i = 0; i < row; ++i)
+            spliced << m_lines.at(i);
+
+        spliced << current.left(column) + inserted.first();
+        for (int i = 1; i < inserted.size() - 1; ++i)
+            spliced << inserted.at(i);
+        spliced << inserted.last() + current.mid(column);
+
+        for (int i = row + 1; i < m_lines.size(); ++i)
+            spliced << m_lines.at(i);
+        m_lines.swap(spliced);
+    }
+
+    m_characters += countCharacters(inserted, 0, inserted.size());
+    m_version++;
+}
+
+void DocumentStore::remove(int startRow, int startColumn, int endRow, int endColumn)
+{
+    const int last = m_lines.size() - 1;
+    if (startRow > last)
+        return;
+
+    // Ace can report removal of the whole lines up to the row after the last one
+    const QString tail = endRow <= last ? m_lines.at(endRow).mid(endColumn) : QString();
+    endRow = qMin(endRow, last);
+
+    m_characters -= countCharacters(m_lines, startRow, endRow + 1);
+    m_lines[startRow] = m_lines.at(startRow).left(startColumn) + tail;
+    if (endRow > startRow)
+        m_lines.erase(m_lines.begin() + startRow + 1, m_lines.begin() + endRow + 1);
+    m_characters += m_lines.at(startRow).size();
+
+    m_version++;
+}
+
+QString DocumentStore::line(int row) const
+{
+    return m_lines.value(row);
+}
+
+int DocumentStore::lineCount() const
+{
+    return m_lines.size();
+}
+
+QStringList DocumentStore::lines() const
+{
+    return m_lines;
+}
+
+qint64 DocumentStore::characterCount() const
+{
+    return m_characters;
+}
+
+int DocumentStore::version() const
+{
+    return m_version;
+}
+
+qint64 DocumentStore::countCharacters(const QStringList &lines, int from, int to)
+{
+    qint64 count = 0;
+    for (int i = from; i < to; ++i)
+        count += lines.at(i).size();
+    return count;
+}
+
+QStringList DocumentStore::splitLines(const QString &text, Editor::LineEnding *dominant)
+{
+    QStringList result;
+    const QChar *data = text.constData();
+    const int size = text.size();
+
+    // Line endings are counted in the same scan
+    int lf = 0, crlf = 0, cr = 0;
+
+    int start = 0;
+    for (int i = 0; i < size; ++i) {
+        const ushort c = data[i].unicode();
+        if (c == '\n') {
+            lf++;
+        } else if (c == '\r') {
+            if (i + 1 < size && data[i + 1].unicode() == '\n') {
+                crlf++;
+                result << QString(data + start, i - start);
+                start = i + 2;
+                ++i;
+                continue;
+            }
+            cr++;
+        } else {
+            continue;
+        }
+
+        result << QString(data + start, i - start);
+        start = i + 1;
+    }
+    result << QString(data + start, size - start);
+
+    if (dominant) {
+        if (crlf > lf && crlf >= cr)
+            *dominant = Editor::LineEndingWindows;
+        else if (cr > lf && cr > crlf)
+            *dominant = Editor::LineEndingMac;
+        else
+            *dominant = Editor::LineEndingUnix;
+    }
+
+    return result;
+}
+
+} // namespace Novile
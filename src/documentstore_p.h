@@ -0,0 +1,145 @@
+/*
+ * This file is part of the Novile Editor
+ * This program is free software licensed under the GNU LGPL. You can
+ * find a copy of this license in LICENSE in the top directory of
+ * the source code.
+ *
+ * Copyright 2013    Illya Kovalevskyy   <illya.kovalevskyy@gmail.com>
+ *
+ */
+
+#ifndef DOCUMENTSTORE_P_H
+#define DOCUMENTSTORE_P_H
+
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+
+#include "editor.h"
+
+namespace Novile
+{
+
+/**
+ * @brief The DocumentStore class
+ *
+ * DocumentStore keeps C++ copy of the Ace document, updated with deltas
+ * pushed by wrapper.js, so reading the document doesn't need JavaScript
+ * calls. Lines are implicitly shared: copying them is cheap.
+ */
+class DocumentStore
+{
+public:
+    DocumentStore();
+
+    /**
+     * @brief Replace the whole document
+     *
+     * Dominant line ending style of @p text becomes style of the document
+     * @param text new contents (any line endings)
+     */
+    void setText(const QString &text);
+
+    /**
+     * @brief Replace the whole document with already split lines
+     * @param lines new contents (at least one line)
+     * @param lineEnding line ending style of the document
+     * @see splitLines()
+     */
+    void setLines(const QStringList &lines, Editor::LineEnding lineEnding);
+
+    /**
+     * @brief Whole document
+     * @return lines, joined with line ending of the document
+     */
+    QString text() const;
+
+    /**
+     * @brief Line ending style, used by text() and for saving
+     * @return style
+     */
+    Editor::LineEnding lineEnding() const;
+
+    /**
+     * @brief Set line ending style, used by text() and for saving
+     * @param lineEnding style
+     */
+    void setLineEnding(Editor::LineEnding lineEnding);
+
+    /**
+     * @brief Line separator for the style
+     * @param lineEnding style
+     * @return "\n", "\r\n" or "\r"
+     */
+    static QString newLine(Editor::LineEnding lineEnding);
+
+    /**
+     * @brief Insert @p text at the position
+     * @param row coordinates: line
+     * @param column coordinates: position from the left
+     * @param text information to be inserted (can be multiline)
+     */
+    void insert(int row, int column, const QString &text);
+
+    /**
+     * @brief Remove text between two positions
+     * @param startRow first line
+     * @param startColumn position in the first line
+     * @param endRow last line
+     * @param endColumn position in the last line (exclusive)
+     */
+    void remove(int startRow, int startColumn, int endRow, int endColumn);
+
+    /**
+     * @brief Contents of the line
+     * @param row line
+     * @return line (empty, if there is no such line)
+     */
+    QString line(int row) const;
+
+    /**
+     * @brief Number of lines (document has at least one line)
+     * @return lines
+     */
+    int lineCount() const;
+
+    /**
+     * @brief All lines of the document (cheap, implicitly shared copy)
+     * @return lines
+     */
+    QStringList lines() const;
+
+    /**
+     * @brief Number of characters in all lines (line breaks aren't counted)
+     *
+     * Count is kept up to date by modifications, it costs nothing
+     * @return characters
+     */
+    qint64 characterCount() const;
+
+    /**
+     * @brief Change counter, increased on each modification
+     * @return version of the document
+     */
+    int version() const;
+
+    /**
+     * @brief Split @p text into lines by "\r\n", "\r" and "\n"
+     * @param text source text
+     * @param dominant the most used line ending (output, optional);
+     * Unix style, if there are no line breaks at all
+     * @return lines (at least one)
+     */
+    static QStringList splitLines(const QString &text, Editor::LineEnding *dominant = 0);
+
+private:
+    static qint64 countCharacters(const QStringList &lines, int from, int to);
+
+    QStringList m_lines;
+    qint64 m_characters;
+    int m_version;
+    Editor::LineEnding m_lineEnding;
+};
+
+} // namespace Novile
+
+#endif // DOCUMENTSTORE_P_H
@@ -0,0 +1,138 @@
+/*
+ * This file is part of the Novile Editor
+ * This program is free software licensed under the GNU LGPL. You can
+ * find a copy of this license in LICENSE in the top directory of
+ * the source code.
+ *
+ * Copyright 2013    Illya Kovalevskyy   <illya.kovalevskyy@gmail.com>
+ *
+ */
+
+#include "editlog_p.h"
+
+namespace Novile
+{
+
+EditLog::EditLog() :
+    m_first(0),
+    m_count(0),
+    m_version(0),
+    m_observed(-1)
+{
+}
+
+void EditLog::reset(int version)
+{
+    m_entries.clear();
+    m_first = 0;
+    m_count = 0;
+    m_version = version;
+    m_observed = -1;
+}
+
+void EditLog::append(const Range &range, const QString &text, int version)
+{
+    const int fromVersion = m_version;
+    const bool mergeable = m_count > 0 && m_observed < fromVersion;
+    m_version = version;
+    if (mergeable && merge(range, text))
+        return;
+
+    Entry entry;
+    entry.fromVersion = fromVersion;
+    entry.change = TextChange(range, text, version);
+
+    if (m_entries.size() < Capacity) {
+        m_entries.append(entry);
+        ++m_count;
+    } else {
+        // Full: overwrite the oldest one
+        m_entries[m_first] = entry;
+        m_first = (m_first + 1) % Capacity;
+    }
+}
+
+void EditLog::observe(int version)
+{
+    m_observed = qMax(m_observed, version);
+}
+
+bool EditLog::changesSince(int version, QVector<TextChange> *changes) const
+{
+    changes->clear();
+    if (version == m_version)
+        return true;
+
+    // Entries are sorted by version: binary search for the boundary
+    int lo = 0;
+    int hi = m_count;
+    while (lo < hi) {
+        const int mid = (lo + hi) / 2;
+        if (at(mid).fromVersion < version)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo == m_count || at(lo).fromVersion != version)
+        return false;
+
+    changes->reserve(m_count - lo);
+    for (int i = lo; i < m_count; ++i)
+        changes->append(at(i).change);
+    return true;
+}
+
+bool EditLog::merge(const Range &range, const QString &text)
+{
+    TextChange &last = at(m_count - 1).change;
+    Range &lastRange = last.range;
+
+    // End of the text, inserted by the last change
+    const int newLines = last.text.count(QLatin1Char('\n'));
+    const int endRow = lastRange.startRow + newLines;
+    const int endColumn = newLines
+            ? last.text.size() - last.text.lastIndexOf(QLatin1Char('\n')) - 1
+            : lastRange.startColumn + last.text.size();
+
+    if (range.isEmpty()) {
+        // Typing on: the next character right after the inserted text
+        if (range.startRow != endRow || range.startColumn != endColumn)
+            return false;
+
+        last.text += text;
+    } else if (!text.isEmpty() || range.startRow != range.endRow) {
+        return false;
+    } else if (!last.text.isEmpty()) {
+        // Erasing just typed characters with backspace
+        const int lineStart = newLines ? 0 : lastRange.startColumn;
+        if (range.startRow != endRow || range.endColumn != endColumn ||
+                range.startColumn < lineStart)
+            return false;
+
+        last.text.chop(range.endColumn - range.startColumn);
+    } else if (range.endRow == lastRange.startRow && range.endColumn == lastRange.startColumn) {
+        // Backspace after backspace
+        lastRange.startColumn = range.startColumn;
+    } else if (range.startRow == lastRange.startRow && range.startColumn == lastRange.startColumn) {
+        // Delete after delete: removed part follows the end of the last one
+        lastRange.endColumn += range.endColumn - range.startColumn;
+    } else {
+        return false;
+    }
+
+    last.version = m_version;
+    return true;
+}
+
+EditLog::Entry &EditLog::at(int index)
+{
+    return m_entries[(m_first + index) % m_entries.size()];
+}
+
+const EditLog::Entry &EditLog::at(int index) const
+{
+    return m_entries.at((m_first + index) % m_entries.size());
+}
+
+} // namespace Novile
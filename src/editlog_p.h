@@ -0,0 +1,90 @@
+/*
+ * This file is part of the Novile Editor
+ * This program is free software licensed under the GNU LGPL. You can
+ * find a copy of this license in LICENSE in the top directory of
+ * the source code.
+ *
+ * Copyright 2013    Illya Kovalevskyy   <illya.kovalevskyy@gmail.com>
+ *
+ */
+
+#ifndef EDITLOG_P_H
+#define EDITLOG_P_H
+
+#include <QtCore/QVector>
+
+#include "novile_types.h"
+
+namespace Novile
+{
+
+/**
+ * @brief The EditLog class
+ *
+ * Bounded log of the last changes of the document (ring buffer), so
+ * consumers can catch up with changes since the version they have seen.
+ *
+ * Typing and erasing are compacted: a change, which continues the last
+ * one (next character, next backspace), is merged into it, unless the
+ * current version has been observed by somebody. So every observed
+ * version stays a boundary of the log.
+ */
+class EditLog
+{
+public:
+    /**
+     * @brief Maximal number of changes in the log
+     */
+    enum { Capacity = 4096 };
+
+    EditLog();
+
+    /**
+     * @brief Forget all changes (e.g. document has been replaced)
+     * @param version current version of the document
+     */
+    void reset(int version);
+
+    /**
+     * @brief Add change of the document
+     * @param range replaced range (in coordinates before the change)
+     * @param text inserted text
+     * @param version version of the document after the change
+     */
+    void append(const Range &range, const QString &text, int version);
+
+    /**
+     * @brief Somebody has seen the version: it mustn't be merged away
+     * @param version version of the document
+     */
+    void observe(int version);
+
+    /**
+     * @brief Changes since the @p version up to the current one
+     * @param version version of the document, consumer has
+     * @param changes changes in order of application (output)
+     * @return false, if the log doesn't reach that version anymore
+     */
+    bool changesSince(int version, QVector<TextChange> *changes) const;
+
+private:
+    struct Entry
+    {
+        int fromVersion;
+        TextChange change;
+    };
+
+    bool merge(const Range &range, const QString &text);
+    Entry &at(int index);
+    const Entry &at(int index) const;
+
+    QVector<Entry> m_entries;
+    int m_first;
+    int m_count;
+    int m_version;
+    int m_observed;
+};
+
+} // namespace Novile
+
+#endif // EDITLOG_P_H
@@ -12,24 +12,28 @@
 #include <QApplication>
 #include <QClipboard>
 #include <QShortcut>
-
-#include <QtWebKit>
-#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
-#include <QtWebKitWidgets>
-#endif
+#include <QtConcurrent>
 
 #include "novile_debug.h"
 #include "editor.h"
 #include "editor_p.h"
+#include "textfile_p.h"
+#include "diff_p.h"
 
 namespace Novile
 {
 
+static QString joinLines(const QStringList &lines, const QString &newLine)
+{
+    return lines.join(newLine);
+}
+
 Editor::Editor(QWidget *parent) :
     QWidget(parent),
     d(new EditorPrivate(this))
 {
     d->startAceWidget();
+    d->applySettings(EditorSettings::defaultSettings(), EditorSettings::AllFields);
     d->executeJavaScript("editor.focus()");
 
     new QShortcut(QKeySequence("Ctrl+A"), this, SLOT(selectAll()));
@@ -37,6 +41,14 @@ Editor::Editor(QWidget *parent) :
 
 Editor::~Editor()
 {
+    d->cancelPendingTexts();
+    delete d;
+}
+
+void Editor::addBundlePath(const QString &path)
+{
+    if (!EditorPrivate::bundlePaths().contains(path))
+        EditorPrivate::bundlePaths().prepend(path);
 }
 
 void Editor::copy()
@@ -53,7 +65,7 @@ void Editor::paste()
     QClipboard *clip = QApplication::clipboard();
     QString text = clip->text(QClipboard::Clipboard);
     if (!text.isEmpty())
-        d->executeJavaScript(QString("editor.insert('%1')").arg(d->escape(text))).toString();
+        d->executeEdit(QString("editor.insert('%1')").arg(d->escape(text)));
 }
 
 void Editor::cut()
@@ -62,15 +74,60 @@ void Editor::cut()
     removeSelectedText();
 }
 
+void Editor::undo()
+{
+    d->executeJavaScript("editor.undo()");
+}
+
+void Editor::redo()
+{
+    d->executeJavaScript("editor.redo()");
+}
+
+bool Editor::isUndoAvailable() const
+{
+    if (d->isHibernated())
+        return !d->hibernatedViewState().undo.isEmpty();
+
+    return d->evaluateJavaScript("editor.session.getUndoManager().hasUndo()").toBool();
+}
+
+bool Editor::isRedoAvailable() const
+{
+    if (d->isHibernated())
+        return !d->hibernatedViewState().redo.isEmpty();
+
+    return d->evaluateJavaScript("editor.session.getUndoManager().hasRedo()").toBool();
+}
+
+void Editor::beginUndoGroup()
+{
+    d->undoGroupDepth++;
+}
+
+void Editor::endUndoGroup()
+{
+    if (d->undoGroupDepth == 0)
+        return;
+
+    if (--d->undoGroupDepth == 0)
+        d->flushPendingEdits();
+}
+
+void Editor::clearUndoHistory()
+{
+    d->executeJavaScript("editor.session.getUndoManager().reset()");
+}
+
 void Editor::selectAll()
 {
     d->executeJavaScript("editor.selectAll()");
 }
 
-void Editor::cursorPosition(int *row, int *column)
+void Editor::cursorPosition(int *row, int *column) const
 {
-    *row = currentLine();
-    *column = currentColumn();
+    *row = d->cursorRow;
+    *column = d->cursorColumn;
 }
 
 void Editor::setCursorPosition(int row, int column)
@@ -82,26 +139,67 @@ void Editor::setCursorPosition(int row, int column)
     }
 }
 
-int Editor::currentLine()
+QVector<Range> Editor::selections() const
 {
-    return d->executeJavaScript("editor.getCursorPosition().row").toInt();
+    if (d->isHibernated())
+        return d->hibernatedViewState().selections;
+
+    const QVariantList flat = d->evaluateJavaScript("getSelections()").toList();
+
+    QVector<Range> ranges;
+    ranges.reserve(flat.size() / 4);
+    for (int i = 0; i + 3 < flat.size(); i += 4) {
+        ranges << Range(flat.at(i).toInt(), flat.at(i + 1).toInt(),
+                        flat.at(i + 2).toInt(), flat.at(i + 3).toInt());
+    }
+    return ranges;
 }
 
-int Editor::currentColumn()
+void Editor::setSelections(const QVector<Range> &ranges)
 {
-    return d->executeJavaScript("editor.getCursorPosition().column").toInt();
+    QStringList flat;
+    flat.reserve(ranges.size());
+    foreach (const Range &range, ranges) {
+        flat << QString("%1,%2,%3,%4").arg(range.startRow).arg(range.startColumn)
+                                      .arg(range.endRow).arg(range.endColumn);
+    }
+
+    d->executeJavaScript(QString("setSelections([%1])").arg(flat.join(",")));
+}
+
+void Editor::insertAtAllCursors(const QString &text)
+{
+    d->executeEdit(QString("insertAtAllCursors('%1')").arg(d->escape(text)));
+}
+
+int Editor::currentLine() const
+{
+    return d->cursorRow;
+}
+
+int Editor::currentColumn() const
+{
+    return d->cursorColumn;
+}
+
+int Editor::firstVisibleLine() const
+{
+    return d->firstVisibleRow;
+}
+
+void Editor::setFirstVisibleLine(int row)
+{
+    d->executeJavaScript(QString("editor.renderer.scrollToRow(%1)").arg(row));
 }
 
 int Editor::lines() const
 {
-    return d->executeJavaScript("property('lines')").toInt();
+    return d->store.lineCount();
 }
 
 QString Editor::line(int row) const
 {
-    return d->executeJavaScript(
-                QString("editor.getSession().getLine(%1)").arg(row)
-           ).toString();
+    return d->store.line(row);
 }
 
 int Editor::lineLength(int row) const
@@ -116,131 +214,497 @@ void Editor::gotoLine(int lineNumber) const
 
 void Editor::insert(const QString &text)
 {
-    d->executeJavaScript(QString("editor.insert('%1')").arg(d->escape(text)));
+    d->executeEdit(QString("editor.insert('%1')").arg(d->escape(text)));
 }
 
 void Editor::insert(int row, int column, const QString &text)
 {
-    if (lines() > row && lineLength(row) > column) {
-        int previousLine, previousColumn;
-        cursorPosition(&previousLine, &previousColumn);
-
-        setCursorPosition(row, column);
-        insert(text);
-
-        // Imaging, that we had this string:
-        // hello, novile edit|or! ("|" - cursor pos)
-        // then, if we insert smth before cursor pos
-        // e.g. after "hello, ", we insert "cool "
-        // we have another string:
-        // hello, cool novile| editor! ("|" - cursor pos)
-        // so, we need to move it 5 sumbols right,
-        // which equals text.size()
-        if (row == previousLine) {
-            if (previousColumn >= column)
-                previousColumn += text.size();
-        }
-
-        setCursorPosition(previousLine, previousColumn);
-    }
+    // Cursor is an anchor in Ace, so if we insert something before it,
+    // it's moved right (or down) automatically
+    const QString request = ""
+            "if (%1 < editor.session.getLength() &&"
+            "    %2 < editor.session.getLine(%1).length)"
+            "    editor.session.insert({row: %1, column: %2}, '%3');";
+    d->executeEdit(request.arg(row).arg(column).arg(d->escape(text)));
 }
 
 bool Editor::isIndentationShown()
 {
-    return d->executeJavaScript("editor.getDisplayIndentGuides()").toBool();
+    return d->settings.isIndentationShown();
 }
 
 void Editor::setIndentationShown(bool is)
 {
-    QString request = "editor.setDisplayIndentGuides(%1)";
-    d->executeJavaScript(request.arg(is));
+    EditorSettings changed = d->settings;
+    changed.setIndentationShown(is);
+    applySettings(changed);
 }
 
 bool Editor::isInvisiblesShown()
 {
-    return d->executeJavaScript("editor.renderer.getShowInvisibles()").toBool();
+    return d->settings.isInvisiblesShown();
 }
 
 void Editor::setInvisiblesShown(bool is)
 {
-    QString request = "editor.renderer.setShowInvisibles(%1)";
-    d->executeJavaScript(request.arg(is));
+    EditorSettings changed = d->settings;
+    changed.setInvisiblesShown(is);
+    applySettings(changed);
 }
 
 bool Editor::isGutterShown()
 {
-    return d->executeJavaScript("editor.renderer.getShowGutter()").toBool();
+    return d->settings.isGutterShown();
 }
 
 void Editor::setGutterShown(bool is)
 {
-    QString request = "editor.renderer.setShowGutter(%1)";
-    d->executeJavaScript(request.arg(is));
+    EditorSettings changed = d->settings;
+    changed.setGutterShown(is);
+    applySettings(changed);
+}
+
+QFuture<QVector<Range> > Editor::computeFoldRanges(FoldMethod method) const
+{
+    return QtConcurrent::run(Folding::compute, d->store.lines(), method);
+}
+
+void Editor::setFoldRanges(const QVector<Range> &ranges)
+{
+    QStringList flat;
+    flat.reserve(ranges.size());
+    foreach (const Range &range, ranges) {
+        flat << QString("%1,%2,%3,%4").arg(range.startRow).arg(range.startColumn)
+                                      .arg(range.endRow).arg(range.endColumn);
+    }
+
+    d->executeJavaScript(QString("setFoldRanges([%1])").arg(flat.join(",")));
+}
+
+void Editor::clearFoldRanges()
+{
+    d->executeJavaScript("setFoldRanges(null)");
+}
+
+void Editor::updateFoldRanges(FoldMethod method)
+{
+    QFutureWatcher<QVector<Range> > *watcher = new QFutureWatcher<QVector<Range> >(d);
+    connect(watcher, SIGNAL(finished()), d, SLOT(onFoldRangesComputed()));
+    watcher->setFuture(computeFoldRanges(method));
+}
+
+void Editor::foldAll()
+{
+    d->executeJavaScript("editor.session.foldAll()");
+}
+
+void Editor::unfoldAll()
+{
+    d->executeJavaScript("editor.session.unfold()");
+}
+
+void Editor::jumpToMatchingBracket()
+{
+    int column, matchRow, matchColumn;
+    if (!d->bracketNearCursor(&column, &matchRow, &matchColumn))
+        return;
+
+    // Cursor stays on the same side of the bracket
+    if (column < d->cursorColumn)
+        ++matchColumn;
+    setCursorPosition(matchRow, matchColumn);
+}
+
+bool Editor::matchingBracket(int row, int column, int *matchRow, int *matchColumn) const
+{
+    return d->brackets.matching(d->store, row, column, matchRow, matchColumn);
+}
+
+bool Editor::enclosingBlock(int row, int column, Range *block) const
+{
+    return d->brackets.enclosing(d->store, row, column, block);
+}
+
+int Editor::bracketDepth(int row, int column) const
+{
+    return d->brackets.depth(d->store, row, column);
+}
+
+QStringList Editor::completions(const QString &prefix, int limit) const
+{
+    return CompletionIndex::instance()->complete(prefix, limit);
+}
+
+void Editor::showCompletions()
+{
+    d->executeJavaScript("showCompletions()");
+}
+
+void Editor::setMemoryBudget(qint64 bytes)
+{
+    EditorPrivate::memoryBudget() = bytes;
+    EditorPrivate::enforceMemoryBudget();
+}
+
+qint64 Editor::memoryBudget()
+{
+    return EditorPrivate::memoryBudget();
+}
+
+bool Editor::isHibernated() const
+{
+    return d->isHibernated();
+}
+
+qint64 Editor::estimatedMemoryUsage() const
+{
+    return d->estimatedMemory();
+}
+
+void Editor::hibernate()
+{
+    d->hibernate();
+}
+
+void Editor::rehydrate()
+{
+    d->rehydrate();
+}
+
+bool Editor::isSuspended() const
+{
+    return d->suspended;
+}
+
+bool Editor::isSuspendWhenHidden() const
+{
+    return d->suspendWhenHidden;
+}
+
+void Editor::setSuspendWhenHidden(bool enabled)
+{
+    d->suspendWhenHidden = enabled;
+    d->setSuspended(enabled && !isVisible());
+}
+
+bool Editor::isTokenizationPaused() const
+{
+    return d->tokenizationPaused;
+}
+
+double Editor::tokenizationProgress() const
+{
+    // Nothing is highlighted, until the page is created again
+    if (d->isHibernated())
+        return 0.0;
+
+    return d->evaluateJavaScript("tokenizerProgress()").toDouble();
+}
+
+void Editor::setTokenizationBudget(int budget, int interval, int rowsPerCheck)
+{
+    const QString request = "setTokenizerBudget(%1, %2, %3)";
+    d->executeJavaScript(request.arg(budget).arg(interval).arg(rowsPerCheck));
+}
+
+void Editor::pauseTokenization()
+{
+    d->tokenizationPaused = true;
+    d->executeJavaScript("setTokenizerPaused(true)");
+}
+
+void Editor::resumeTokenization()
+{
+    d->tokenizationPaused = false;
+    d->executeJavaScript("setTokenizerPaused(false)");
+}
+
+bool Editor::isNativeBracketMatching() const
+{
+    return d->nativeBracketMatching;
+}
+
+void Editor::setNativeBracketMatching(bool enabled)
+{
+    if (enabled == d->nativeBracketMatching)
+        return;
+
+    d->nativeBracketMatching = enabled;
+    d->executeJavaScript(QString("setNativeBracketMatching(%1)").arg(enabled));
+
+    if (enabled)
+        d->highlightBrackets();
+    else
+        clearMarkers("bracket");
 }
 
 bool Editor::isFadeFoldMarker()
 {
-    return d->executeJavaScript("editor.getFadeFoldWidgets()").toBool();
+    return d->settings.isFadeFoldMarker();
 }
 
 void Editor::setFadeFoldMarker(bool is)
 {
-    QString request = "editor.setFadeFoldWidgets(%1)";
-    d->executeJavaScript(request.arg(is));
+    EditorSettings changed = d->settings;
+    changed.setFadeFoldMarker(is);
+    applySettings(changed);
 }
 
 bool Editor::isHighlightSelectedWord()
 {
-    return d->executeJavaScript("editor.getHighlightSelectedWord()").toBool();
+    return d->settings.isHighlightSelectedWord();
 }
 
 void Editor::setHighlightSelectedWord(bool is)
 {
-    QString request = "editor.setHighlightSelectedWord(%1)";
-    d->executeJavaScript(request.arg(is));
+    EditorSettings changed = d->settings;
+    changed.setHighlightSelectedWord(is);
+    applySettings(changed);
 }
 
 bool Editor::isActiveLineHighlighted()
 {
-    return d->executeJavaScript("editor.getHighlightActiveLine()").toBool();
+    return d->settings.isActiveLineHighlighted();
 }
 
 void Editor::setActiveLineHighlighted(bool is)
 {
-    QString request = "editor.setHighlightActiveLine(%1)";
-    d->executeJavaScript(request.arg(is));
+    EditorSettings changed = d->settings;
+    changed.setActiveLineHighlighted(is);
+    applySettings(changed);
 }
 
 QString Editor::text() const
 {
-    return d->executeJavaScript("editor.getSession().getValue()").toString();
+    return d->store.text();
+}
+
+int Editor::version() const
+{
+    d->log.observe(d->store.version());
+    return d->store.version();
+}
+
+bool Editor::changesSince(int version, QVector<TextChange> *changes) const
+{
+    d->log.observe(d->store.version());
+    return d->log.changesSince(version, changes);
+}
+
+DocumentSnapshot Editor::snapshot() const
+{
+    d->log.observe(d->store.version());
+    return DocumentSnapshot(d->store.lines(),
+                            DocumentStore::newLine(d->store.lineEnding()),
+                            d->store.version());
+}
+
+QByteArray Editor::saveState() const
+{
+    return d->saveViewState();
+}
+
+bool Editor::restoreState(const QByteArray &state)
+{
+    return d->restoreViewState(state);
 }
 
 void Editor::setText(const QString &newText)
 {
-    const QString request = "editor.getSession().setValue('%1')";
-    d->executeJavaScript(request.arg(d->escape(newText)));
-    int lastLine = lines()-1;
-    setCursorPosition(lastLine, lineLength(lastLine));
+    d->cancelPendingTexts();
+    d->applyText(EditorPrivate::prepareText(newText));
+}
+
+void Editor::setTextPreserving(const QString &newText)
+{
+    d->cancelPendingTexts();
+
+    // Difference is computed against the store, it must be up to date:
+    // edits of the open undo group are applied first
+    d->flushPendingEdits();
+    d->waitForDeltas();
+
+    LineEnding lineEnding;
+    const QStringList newLines = DocumentStore::splitLines(newText, &lineEnding);
+    if (newLines.size() > 1)
+        setLineEnding(lineEnding); // document is modified, if the style differs
+
+    const QStringList oldLines = d->store.lines();
+    const QVector<DiffHunk> hunks = Diff::compute(oldLines, newLines);
+    if (hunks.isEmpty())
+        return;
+
+    // Edits go bottom-up, so rows of the upper hunks stay valid; the
+    // store is updated by deltas, which Ace pushes back
+    const int lastRow = oldLines.size() - 1;
+    QStringList edits;
+    for (int i = hunks.size() - 1; i >= 0; --i) {
+        const DiffHunk &hunk = hunks.at(i);
+        QString replacement = newLines.mid(hunk.newStart, hunk.newCount).join("\n");
+        int startRow = hunk.oldStart;
+        int startColumn = 0;
+        int endRow, endColumn;
+
+        if (hunk.oldCount > 0 && hunk.newCount > 0) {
+            endRow = hunk.oldStart + hunk.oldCount - 1;
+            endColumn = oldLines.at(endRow).length();
+        } else if (hunk.oldCount == 0) {
+            // Insertion before the line or after the last one
+            if (hunk.oldStart <= lastRow) {
+                replacement += '\n';
+            } else {
+                startRow = lastRow;
+                startColumn = oldLines.at(lastRow).length();
+                replacement.prepend('\n');
+            }
+            endRow = startRow;
+            endColumn = startColumn;
+        } else {
+            // Removal of whole lines, last ones take the line break before them
+            endRow = hunk.oldStart + hunk.oldCount;
+            endColumn = 0;
+            if (endRow > lastRow) {
+                endRow = lastRow;
+                endColumn = oldLines.at(lastRow).length();
+                if (startRow > 0) {
+                    --startRow;
+                    startColumn = oldLines.at(startRow).length();
+                }
+            }
+        }
+
+        edits << QString("%1,%2,%3,%4,'%5'").arg(startRow).arg(startColumn)
+                                            .arg(endRow).arg(endColumn)
+                                            .arg(d->escape(replacement));
+    }
+
+    beginUndoGroup();
+    d->executeEdit(QString("replaceRanges([%1])").arg(edits.join(",")));
+    endUndoGroup();
+}
+
+QFuture<QString> Editor::textAsync() const
+{
+    // Lines are implicitly shared, so the worker gets a snapshot for free
+    return QtConcurrent::run(joinLines,
+                             d->store.lines(),
+                             DocumentStore::newLine(d->store.lineEnding()));
+}
+
+QFuture<int> Editor::linesAsync() const
+{
+    // Number of lines is always known: future is ready at once
+    const int count = d->store.lineCount();
+    QFutureInterface<int> result(QFutureInterfaceBase::Started);
+    result.reportFinished(&count);
+    return result.future();
+}
+
+QFuture<void> Editor::setTextAsync(const QString &newText)
+{
+    return d->queueText(QtConcurrent::run(EditorPrivate::prepareText, newText));
+}
+
+QFuture<bool> Editor::loadFromFileAsync(const QString &fileName)
+{
+    return d->queueText(QtConcurrent::run(EditorPrivate::prepareFile, fileName));
+}
+
+Editor::LineEnding Editor::lineEnding() const
+{
+    return d->store.lineEnding();
+}
+
+void Editor::setLineEnding(LineEnding lineEnding)
+{
+    if (lineEnding == d->store.lineEnding())
+        return;
+
+    // Saved file would be different now
+    d->store.setLineEnding(lineEnding);
+    setModified(true);
+}
+
+bool Editor::isModified() const
+{
+    return d->isModified();
+}
+
+void Editor::setModified(bool modified)
+{
+    d->setSavedVersion(modified ? -1 : d->store.version());
+}
+
+bool Editor::loadFromFile(const QString &fileName)
+{
+    const PreparedText prepared = EditorPrivate::prepareFile(fileName);
+    if (!prepared.success)
+        return false;
+
+    d->cancelPendingTexts();
+    d->applyText(prepared);
+    return true;
+}
+
+QFuture<bool> Editor::saveToFile(const QString &fileName, const QByteArray &encoding)
+{
+    QFutureWatcher<bool> *watcher = new QFutureWatcher<bool>(d);
+    watcher->setProperty("fileName", fileName);
+    watcher->setProperty("version", d->store.version());
+    connect(watcher, SIGNAL(finished()), d, SLOT(onSaveFinished()));
+
+    const bool byDefault = encoding.isEmpty() || encoding == d->encoding;
+
+    // Lines are implicitly shared, so the worker gets a snapshot for free
+    QFuture<bool> future = QtConcurrent::run(TextFile::write,
+                                             fileName,
+                                             d->store.lines(),
+                                             DocumentStore::newLine(d->store.lineEnding()),
+                                             byDefault ? d->encoding : encoding,
+                                             byDefault && d->byteOrderMark);
+    watcher->setFuture(future);
+    return future;
+}
+
+QByteArray Editor::encoding() const
+{
+    return d->encoding;
+}
+
+void Editor::setEncoding(const QByteArray &encoding, bool byteOrderMark)
+{
+    d->encoding = encoding;
+    d->byteOrderMark = byteOrderMark;
 }
 
 QString Editor::selectedText() const
 {
-    return d->executeJavaScript("editor.getCopyText()").toString();
+    if (!d->isHibernated())
+        return d->evaluateJavaScript("editor.getCopyText()").toString();
+
+    // Same as getCopyText(): texts of all selections, joined with line breaks
+    QStringList texts;
+    bool empty = true;
+    foreach (const Range &range, d->hibernatedViewState().selections) {
+        texts << d->textOf(range);
+        empty = empty && texts.last().isEmpty();
+    }
+    return empty ? QString() : texts.join("\n");
 }
 
 void Editor::removeSelectedText()
 {
-    d->executeJavaScript("editor.remove(editor.getSelectionRange())");
+    d->executeEdit("editor.remove(editor.getSelectionRange())");
 }
 
 bool Editor::isReadOnly() const
 {
-    return d->executeJavaScript("editor.getReadOnly()").toBool();
+    return d->readOnly;
 }
 
 void Editor::setReadOnly(bool readOnly)
 {
+    d->readOnly = readOnly;
     if (readOnly) {
         d->executeJavaScript("editor.setReadOnly(true)");
     } else {
@@ -250,26 +714,43 @@ void Editor::setReadOnly(bool readOnly)
 
 void Editor::showPrintMargin()
 {
-    d->executeJavaScript("editor.setShowPrintMargin(true)");
+    EditorSettings changed = d->settings;
+    changed.setPrintMarginShown(true);
+    applySettings(changed);
 }
 
 void Editor::hidePrintMargin()
 {
-    d->executeJavaScript("editor.setShowPrintMargin(false)");
+    EditorSettings changed = d->settings;
+    changed.setPrintMarginShown(false);
+    applySettings(changed);
+}
+
+bool Editor::isPrintMarginShown() const
+{
+    return d->settings.isPrintMarginShown();
 }
 
 int Editor::fontSize()
 {
-    return  d->executeJavaScript("document.getElementById('editor').style.fontSize")
-            .toString()
-            .replace("px", "")
-            .toInt();
+    return d->settings.fontSize();
 }
 
 void Editor::setFontSize(int px)
 {
-    const QString request = "document.getElementById('editor').style.fontSize='%1px'";
-    d->executeJavaScript(request.arg(px));
+    EditorSettings changed = d->settings;
+    changed.setFontSize(px);
+    applySettings(changed);
+}
+
+EditorSettings Editor::settings() const
+{
+    return d->settings;
+}
+
+void Editor::applySettings(const EditorSettings &settings)
+{
+    d->applySettings(settings, EditorSettings::AllFields);
 }
 
 void Editor::setHighlightMode(int mode)
@@ -370,18 +851,25 @@ void Editor::setHighlightMode(int mode)
 
 void Editor::setHighlightMode(const QString &name, const QUrl &url)
 {
+    if (url.scheme() == "qrc")
+        EditorPrivate::ensureResource(url.path().mid(1));
+
     const QString request = ""
-            "$.getScript('%1');"
-            "editor.getSession().setMode('ace/mode/%2');";
-    d->executeJavaScript(request.arg(url.toString()).arg(name));
+            "if (loadScript('%1'))"
+            "    editor.getSession().setMode('ace/mode/%2');";
+    d->modeRequest = request.arg(url.toString()).arg(name);
+    d->executeJavaScript(d->modeRequest);
 }
 
 void Editor::setHighlightMode(const QString &name)
 {
+    EditorPrivate::ensureResource("ace/mode-" + name + ".js");
+
     const QString request = ""
-            "$.getScript('%1');"
-            "editor.getSession().setMode('ace/mode/%2');";
-    d->executeJavaScript(request.arg("qrc:/ace/mode-"+name+".js").arg(name));
+            "if (loadScript('%1'))"
+            "    editor.getSession().setMode('ace/mode/%2');";
+    d->modeRequest = request.arg("qrc:/ace/mode-"+name+".js").arg(name);
+    d->executeJavaScript(d->modeRequest);
 }
 
 void Editor::setTheme(int theme)
@@ -412,7 +900,7 @@ void Editor::setTheme(int theme)
         setTheme("solarized_dark");
         return;
     case ThemeTomorrowNightBright:
-        setTheme("tomorrow_midnight_bright");
+        setTheme("tomorrow_night_bright");
         return;
     case ThemeTwilight:
         setTheme("twilight");
@@ -425,24 +913,114 @@ void Editor::setTheme(int theme)
 
 void Editor::setTheme(const QString &name, const QUrl &url)
 {
+    if (url.scheme() == "qrc")
+        EditorPrivate::ensureResource(url.path().mid(1));
+
     const QString request = ""
-            "$.getScript('%1');"
-            "editor.setTheme('ace/theme/%2');";
-    d->executeJavaScript(request.arg(url.toString()).arg(name));
+            "if (loadScript('%1'))"
+            "    editor.setTheme('ace/theme/%2');";
+    d->themeRequest = request.arg(url.toString()).arg(name);
+    d->settings.setTheme(name);
+    d->executeJavaScript(d->themeRequest);
 }
 
 void Editor::setTheme(const QString &name)
 {
-    const QString request = ""
-            "$.getScript('%1');"
-            "editor.setTheme('ace/theme/%2');";
-    d->executeJavaScript(request.arg("qrc:/ace/theme-"+name+".js").arg(name));
+    EditorSettings changed = d->settings;
+    changed.setTheme(name);
+    applySettings(changed);
+}
+
+void Editor::setAnnotations(const QVector<Annotation> &annotations)
+{
+    if (annotations == d->annotations)
+        return;
+
+    // Hibernated editor sends them, when it's rehydrated
+    if (d->isHibernated()) {
+        d->annotations = annotations;
+        return;
+    }
+
+    static const char *types[] = { "error", "warning", "info" };
+
+    QStringList entries;
+    entries.reserve(annotations.size());
+    foreach (const Annotation &annotation, annotations) {
+        const QString entry = "{row: %1, column: %2, text: '%3', type: '%4'}";
+        // One arg() call: %N in the text mustn't be taken as a placeholder
+        entries << entry.arg(QString::number(annotation.row),
+                             QString::number(annotation.column),
+                             d->escape(annotation.text),
+                             QLatin1String(types[annotation.type]));
+    }
+
+    const QString request = "editor.session.setAnnotations([%1])";
+    d->executeJavaScript(request.arg(entries.join(",")));
+    d->annotations = annotations;
+}
+
+void Editor::clearAnnotations()
+{
+    setAnnotations(QVector<Annotation>());
+}
+
+void Editor::setMarkers(const QString &layer, const QVector<Range> &ranges)
+{
+    QSet<Range> &current = d->markerLayers[layer];
+    QSet<Range> updated;
+    updated.reserve(ranges.size());
+    foreach (const Range &range, ranges)
+        updated.insert(range);
+
+    // Hibernated editor sends all layers, when it's rehydrated
+    if (d->isHibernated()) {
+        current = updated;
+        return;
+    }
+
+    // Send only the difference: ranges are flattened into
+    // [startRow, startColumn, endRow, endColumn, ...] arrays
+    QStringList removed, added;
+    foreach (const Range &range, current) {
+        if (!updated.contains(range)) {
+            removed << QString("%1,%2,%3,%4").arg(range.startRow).arg(range.startColumn)
+                                             .arg(range.endRow).arg(range.endColumn);
+        }
+    }
+    foreach (const Range &range, updated) {
+        if (!current.contains(range)) {
+            added << QString("%1,%2,%3,%4").arg(range.startRow).arg(range.startColumn)
+                                           .arg(range.endRow).arg(range.endColumn);
+        }
+    }
+
+    if (!removed.isEmpty() || !added.isEmpty()) {
+        const QString request = "updateMarkers('%1', [%2], [%3])";
+        d->executeJavaScript(request.arg(d->escape(layer), removed.join(","), added.join(",")));
+    }
+    current = updated;
+}
+
+void Editor::clearMarkers(const QString &layer)
+{
+    setMarkers(layer, QVector<Range>());
+}
+
+void Editor::setMarkerStyle(const QString &layer, const QString &css, MarkerType type)
+{
+    const QString request = "setMarkerStyle('%1', '%2', %3)";
+    d->executeJavaScript(request.arg(d->escape(layer), d->escape(css),
+                                     d->boolean(type == MarkerFullLine)));
 }
 
 bool Editor::eventFilter(QObject *object, QEvent *filteredEvent)
 {
     Q_UNUSED(object);
 
+    if (filteredEvent->type() == QEvent::FocusIn)
+        d->touch();
+
     // Key press filters
     if (filteredEvent->type() == QEvent::KeyPress) {
         QKeyEvent *event = (QKeyEvent*)filteredEvent;
@@ -468,4 +1046,22 @@ bool Editor::eventFilter(QObject *object, QEvent *filteredEvent)
     return false;
 }
 
+void Editor::showEvent(QShowEvent *event)
+{
+    d->setSuspended(false);
+    d->touch();
+    d->rehydrate();
+    QWidget::showEvent(event);
+}
+
+void Editor::hideEvent(QHideEvent *event)
+{
+    // Minimized window sends spontaneous hide events to its children too
+    if (d->suspendWhenHidden)
+        d->setSuspended(true);
+    QWidget::hideEvent(event);
+
+    EditorPrivate::enforceMemoryBudget();
+}
+
 } // namespace Novile
@@ -13,7 +13,13 @@
 
 #include <QWidget>
 #include <QUrl>
+#include <QVector>
+#include <QFuture>
+#include <QStringList>
 #include "novile_export.h"
+#include "novile_types.h"
+#include "documentsnapshot.h"
+#include "editorsettings.h"
 
 namespace Novile
 {
@@ -38,6 +44,7 @@ class NOVILE_EXPORT Editor : public QWidget
     Q_PROPERTY(bool invisiblesShown READ isInvisiblesShown WRITE setInvisiblesShown)
     Q_PROPERTY(bool fadeFoldMarker READ isFadeFoldMarker WRITE setFadeFoldMarker)
     Q_PROPERTY(bool gutterShown READ isGutterShown WRITE setGutterShown)
+    Q_PROPERTY(bool nativeBracketMatching READ isNativeBracketMatching WRITE setNativeBracketMatching)
 public:
     /**
      * @brief Default highlight lexers
@@ -133,6 +140,40 @@ public:
         ThemeVibrantInk
     };
 
+    /**
+     * @brief Line ending styles
+     */
+    enum LineEnding {
+        /// "\n" (Unix, Linux, OS X)
+        LineEndingUnix = 0,
+        /// "\r\n" (Windows)
+        LineEndingWindows,
+        /// "\r" (classic Mac OS)
+        LineEndingMac
+    };
+
+    /**
+     * @brief Fold range providers, computed on the C++ side
+     * @see computeFoldRanges()
+     */
+    enum FoldMethod {
+        /// Blocks of lines indented deeper than the line before them
+        FoldIndentation = 0,
+        /// Multiline blocks between matching brackets
+        FoldBrackets
+    };
+
+    /**
+     * @brief How markers of a layer are painted
+     * @see setMarkerStyle()
+     */
+    enum MarkerType {
+        /// Exactly the range of text
+        MarkerText = 0,
+        /// Whole lines of the range, up to the right edge
+        MarkerFullLine
+    };
+
     /**
      * @brief Regular constructor
      * @param parent widget, used as parent
@@ -140,26 +181,46 @@ public:
     explicit Editor(QWidget *parent = 0);
     ~Editor();
 
+    /**
+     * @brief Add directory, where mode and theme bundles (*.rcc) are looked for
+     *
+     * Modes and themes are registered only when they're needed first time,
+     * so applications can ship (or load from plugins) only bundles they use.
+     * Install directory and NOVILE_BUNDLE_PATH are searched by default.
+     * @param path directory with bundles
+     */
+    static void addBundlePath(const QString &path);
+
     /**
      * @brief Short way of cursorPosition()
      * @return line, on which cursor is located
      * @see cursorPosition
      */
-    int currentLine();
+    int currentLine() const;
 
     /**
      * @brief Short way of cursorPosition()
      * @return column, on which cursor is located
      * @see cursorPosition
      */
-    int currentColumn();
+    int currentColumn() const;
+
+    /**
+     * @brief First line, visible in the editor (scroll position)
+     * @return line number
+     * @see setFirstVisibleLine()
+     */
+    int firstVisibleLine() const;
 
     /**
      * @brief Current position of the cursor in the document
+     *
+     * Position is cached on each cursor move, so it's cheap to call it
+     * as often as you want and both coordinates are always consistent.
      * @param row coordinates: line
      * @param column coordinates: position from the left
      */
-    void cursorPosition(int *row, int *column);
+    void cursorPosition(int *row, int *column) const;
 
     /**
      * @brief Number of source lines
@@ -223,6 +284,110 @@ public:
      */
     QString text() const;
 
+    /**
+     * @brief Line ending style of the document
+     *
+     * It's detected by setText() and loadFromFile() (the most used one) and
+     * used by text() and saveToFile(), so original line endings are kept
+     * @return style
+     */
+    LineEnding lineEnding() const;
+
+    /**
+     * @brief Version of the document
+     *
+     * Version is increased by every change of the document
+     * @return current version
+     * @see changesSince()
+     */
+    int version() const;
+
+    /**
+     * @brief Changes of the document since the @p version
+     *
+     * Last changes are kept in a bounded log, where typing and erasing
+     * are merged into single changes. Versions, which have been returned
+     * by version(), snapshot() or seen by changesSince(), are never merged
+     * away, so consumers can catch up incrementally.
+     * @param version version, consumer has seen last time
+     * @param changes changes in order of application (output)
+     * @return false, if the log doesn't reach that version anymore (then
+     * whole document should be re-read)
+     */
+    bool changesSince(int version, QVector<TextChange> *changes) const;
+
+    /**
+     * @brief Immutable view of the current document
+     *
+     * Unlike a series of line() calls, snapshot can't be torn by edits.
+     * It's cheap (lines are shared, not copied) and can be passed to
+     * worker threads for linting, indexing and so on.
+     * @return snapshot of the current version
+     */
+    DocumentSnapshot snapshot() const;
+
+    /**
+     * @brief Save view state: cursor, selections, scroll position, folds
+     * and undo history
+     *
+     * State is taken from the page with one call and kept in a compact
+     * binary blob with a fingerprint of the document. Hibernated editor
+     * returns the state it keeps, without waking up.
+     * @return blob for restoreState()
+     * @see restoreState()
+     */
+    QByteArray saveState() const;
+
+    /**
+     * @brief Restore view state, saved by saveState()
+     *
+     * State is applied with one call, so set the text first. If the
+     * document differs from the saved one, undo history and folds are
+     * dropped and only cursor, selections and scroll position are restored.
+     * Hibernated editor only keeps the state until it's rehydrated.
+     * @param state blob, returned by saveState()
+     * @return is the blob valid?
+     */
+    bool restoreState(const QByteArray &state);
+
+    /**
+     * @brief Source code from editor, joined in the background
+     * @return future with source code
+     * @see text()
+     */
+    QFuture<QString> textAsync() const;
+
+    /**
+     * @brief Number of source lines
+     *
+     * It's known without any calls to Ace, so the future is ready at once.
+     * It's here to be pipelined with other asynchronous calls.
+     * @return future with lines in the source
+     * @see lines()
+     */
+    QFuture<int> linesAsync() const;
+
+    /**
+     * @brief Set source code for editor in the background
+     *
+     * Splitting and escaping are done by the worker thread, the document is
+     * set when the event loop gets control back. Documents are set in order
+     * of the calls; setText() and loadFromFile() cancel pending ones.
+     * @param newText new source code
+     * @return future, which is finished when the document is set
+     * @see setText()
+     */
+    QFuture<void> setTextAsync(const QString &newText);
+
+    /**
+     * @brief All selections (and cursors) in the editor
+     *
+     * There is always at least one: cursor is an empty selection
+     * @return selected ranges, fetched in one call
+     * @see setSelections()
+     */
+    QVector<Range> selections() const;
+
     /**
      * @brief Get selected text from the editor
      * @return selected texts
@@ -235,12 +400,232 @@ public:
      */
     bool isReadOnly() const;
 
+    /**
+     * @brief Has document been changed since it was set or saved?
+     *
+     * It's driven by the change counter, so it's cheap to call
+     * @return is it?
+     * @see modificationChanged()
+     */
+    bool isModified() const;
+
+    /**
+     * @brief Load the document from the file, detecting its encoding
+     *
+     * Byte order marks (UTF-8, UTF-16, UTF-32) are recognized, files
+     * without them are read as UTF-16 if every second byte is zero (ASCII
+     * text in UTF-16), as UTF-8 if they are valid UTF-8 or as Latin-1
+     * otherwise. Encoding (and BOM) is remembered for saveToFile().
+     * @param fileName source file
+     * @return is file loaded?
+     * @see encoding()
+     */
+    bool loadFromFile(const QString &fileName);
+
+    /**
+     * @brief Load the document from the file in the background
+     *
+     * Reading, decoding and splitting are done by the worker thread, the
+     * document is set when the event loop gets control back. Documents are
+     * set in order of the calls; setText() and loadFromFile() cancel
+     * pending ones.
+     * @param fileName source file
+     * @return future with the result: is file loaded?
+     * @see loadFromFile()
+     */
+    QFuture<bool> loadFromFileAsync(const QString &fileName);
+
+    /**
+     * @brief Write the document to the file in the background
+     *
+     * Document is snapshotted (cheap, copy-on-write), then it's encoded and
+     * written by the worker thread into the temporary file, which atomically
+     * replaces @p fileName. Document is marked as unmodified, if it hasn't
+     * been changed since the call.
+     * @param fileName destination file
+     * @param encoding name of the codec for QTextCodec, e.g. "UTF-8";
+     * encoding() (with its byte order mark, if any) is used by default
+     * @return future with the result: is file saved?
+     * @see saveFinished()
+     */
+    QFuture<bool> saveToFile(const QString &fileName, const QByteArray &encoding = QByteArray());
+
+    /**
+     * @brief Encoding of the document, used for saving
+     * @return codec name, e.g. "UTF-8" (default) or "UTF-16LE"
+     */
+    QByteArray encoding() const;
+
+    /**
+     * @brief Set encoding of the document, used for saving
+     * @param encoding codec name (as for QTextCodec)
+     * @param byteOrderMark write byte order mark at the beginning or not
+     */
+    void setEncoding(const QByteArray &encoding, bool byteOrderMark = false);
+
+    /**
+     * @brief Compute fold ranges of the document in the background
+     *
+     * Document is snapshotted (cheap, copy-on-write) and walked by the
+     * worker thread, so JavaScript engine isn't involved at all
+     * @param method fold range provider
+     * @return future with ranges, sorted by start row
+     * @see setFoldRanges()
+     */
+    QFuture<QVector<Range> > computeFoldRanges(FoldMethod method) const;
+
+    /**
+     * @brief Find bracket, matching the one at the position
+     *
+     * Brackets are looked up in the C++ index, which is updated with
+     * changed lines only, so it's O(log n) even for huge documents.
+     * Brackets inside quoted strings are skipped.
+     * @param row line of the bracket
+     * @param column position of the bracket in the line
+     * @param matchRow line of the matching bracket (output)
+     * @param matchColumn position of the matching bracket (output)
+     * @return is there a bracket at the position with the matching one?
+     */
+    bool matchingBracket(int row, int column, int *matchRow, int *matchColumn) const;
+
+    /**
+     * @brief Find the innermost pair of brackets around the position
+     * @param row coordinates: line
+     * @param column coordinates: position from the left
+     * @param block range from the opening bracket to the closing one (inclusive)
+     * @return is position inside any brackets?
+     */
+    bool enclosingBlock(int row, int column, Range *block) const;
+
+    /**
+     * @brief Nesting depth of brackets at the position
+     * @param row coordinates: line
+     * @param column coordinates: position from the left
+     * @return number of brackets, which are open before the position
+     */
+    int bracketDepth(int row, int column) const;
+
+    /**
+     * @brief Words for completion of the @p prefix
+     *
+     * Words are collected from all open documents and kept in a sorted
+     * index, which is updated with changed lines only
+     * @param prefix beginning of the word
+     * @param limit maximal number of words
+     * @return words in alphabetical order (without the prefix itself)
+     * @see showCompletions()
+     */
+    QStringList completions(const QString &prefix, int limit = 50) const;
+
+    /**
+     * @brief Limit memory of all editors in the process
+     *
+     * When estimated memory of all editors exceeds the budget, hidden
+     * editors are hibernated, the least recently used (shown or focused)
+     * first. Visible editors are never hibernated.
+     * @param bytes budget (0 means unlimited, default)
+     * @see hibernate(), estimatedMemoryUsage()
+     */
+    static void setMemoryBudget(qint64 bytes);
+
+    /**
+     * @brief Memory budget of all editors in the process
+     * @return bytes (0 means unlimited)
+     */
+    static qint64 memoryBudget();
+
+    /**
+     * @brief Is web view of the editor torn down?
+     * @return is it?
+     * @see hibernate()
+     */
+    bool isHibernated() const;
+
+    /**
+     * @brief Rough estimate of memory, taken by the editor
+     *
+     * Web page and Ace's copies of the text are estimated, not measured
+     * @return bytes
+     */
+    qint64 estimatedMemoryUsage() const;
+
+    /**
+     * @brief Is editor suspended now (hidden with suspendWhenHidden)?
+     * @return is it?
+     * @see setSuspendWhenHidden()
+     */
+    bool isSuspended() const;
+
+    /**
+     * @brief Is editor suspended, when it's hidden or minimized?
+     * @return is it?
+     */
+    bool isSuspendWhenHidden() const;
+
+    /**
+     * @brief Is background highlighting paused?
+     * @return is it?
+     * @see pauseTokenization()
+     */
+    bool isTokenizationPaused() const;
+
+    /**
+     * @brief How much of the document is highlighted by the background tokenizer
+     *
+     * Visible lines are highlighted on demand regardless of it
+     * @return part of the document from 0.0 to 1.0 (0.0 for hibernated editor)
+     */
+    double tokenizationProgress() const;
+
+    /**
+     * @brief Are brackets near the cursor highlighted by Novile?
+     * @return are they?
+     * @see setNativeBracketMatching()
+     */
+    bool isNativeBracketMatching() const;
+
+    /**
+     * @brief Is there something to undo?
+     * @return is it?
+     */
+    bool isUndoAvailable() const;
+
+    /**
+     * @brief Is there something to redo?
+     * @return is it?
+     */
+    bool isRedoAvailable() const;
+
     /**
      * @brief Font size of the source text
      * @return size in pixels
      */
     int fontSize();
 
+    /**
+     * @brief Is print margin (semi-transparent line at right) shown?
+     * @return is it?
+     */
+    bool isPrintMarginShown() const;
+
+    /**
+     * @brief Visual options, which have been applied to the editor
+     *
+     * Settings are kept in C++, so reading them costs no calls to the page
+     * @return settings
+     * @see applySettings()
+     */
+    EditorSettings settings() const;
+
+    /**
+     * @brief Apply visual options in one call
+     *
+     * Only the fields, which differ from settings(), are sent
+     * @param settings new options
+     * @see EditorSettings::setDefault()
+     */
+    void applySettings(const EditorSettings &settings);
+
 public slots:
     /**
      * @brief Copy selected text to the buffer
@@ -257,6 +642,39 @@ public slots:
      */
     void cut();
 
+    /**
+     * @brief Revert the last change of the document
+     */
+    void undo();
+
+    /**
+     * @brief Repeat the last reverted change of the document
+     */
+    void redo();
+
+    /**
+     * @brief Start grouping of edits into the single undo entry
+     *
+     * insert(), paste(), cut() and removeSelectedText() are queued until
+     * the matching endUndoGroup() and then applied all at once, in one
+     * call to Ace, as a single undo step. Groups can be nested: only the
+     * outermost endUndoGroup() applies them. Keep in mind, that document
+     * (and cursor) aren't changed until the group is closed.
+     * @see endUndoGroup()
+     */
+    void beginUndoGroup();
+
+    /**
+     * @brief Finish the group of edits started by beginUndoGroup()
+     * @see beginUndoGroup()
+     */
+    void endUndoGroup();
+
+    /**
+     * @brief Forget all undo and redo history
+     */
+    void clearUndoHistory();
+
     /**
      * @brief Selects the whole text in the editor
      */
@@ -269,12 +687,36 @@ public slots:
      */
     void setCursorPosition(int row, int column);
 
+    /**
+     * @brief Replace all selections with @p ranges, transferred in one call
+     *
+     * Each empty range is a cursor, so it's the fast way to place hundreds
+     * of cursors. Overlapping ranges are merged.
+     * @param ranges new selections (the last one becomes primary)
+     * @see selections()
+     */
+    void setSelections(const QVector<Range> &ranges);
+
+    /**
+     * @brief Insert @p text at every cursor (replacing selected text)
+     *
+     * All insertions are made in one call and form a single undo step
+     * @param text information to be inserted
+     */
+    void insertAtAllCursors(const QString &text);
+
     /**
      * @brief Changes cursor position (=row) to set
      * @param lineNumber new cursor's row
      */
     void gotoLine(int lineNumber) const;
 
+    /**
+     * @brief Scroll the editor, so the line is at the top (cursor stays)
+     * @param row line number
+     */
+    void setFirstVisibleLine(int row);
+
     /**
      * @brief Insert @p text at the current cursor position
      * @param text information to be inserted
@@ -307,6 +749,122 @@ public slots:
      */
     void setGutterShown(bool is);
 
+    /**
+     * @brief Replace fold ranges of the document, transferred in one call
+     *
+     * Fold widgets are shown only for the start rows of these ranges, so
+     * Ace doesn't compute them itself (e.g. ranges come from an outline).
+     * Ranges stay until the next call, even if highlight mode is changed.
+     * @param ranges multiline ranges (one per start row)
+     * @see clearFoldRanges(), updateFoldRanges()
+     */
+    void setFoldRanges(const QVector<Range> &ranges);
+
+    /**
+     * @brief Return folding to the rules of the current highlight mode
+     * @see setFoldRanges()
+     */
+    void clearFoldRanges();
+
+    /**
+     * @brief Compute fold ranges in the background and set them when ready
+     * @param method fold range provider
+     * @see computeFoldRanges(), setFoldRanges()
+     */
+    void updateFoldRanges(FoldMethod method);
+
+    /**
+     * @brief Fold every foldable range of the document
+     */
+    void foldAll();
+
+    /**
+     * @brief Unfold everything in the document
+     */
+    void unfoldAll();
+
+    /**
+     * @brief Show completion popup for the word before the cursor
+     *
+     * Popup is bound to Ctrl-Space as well
+     * @see completions()
+     */
+    void showCompletions();
+
+    /**
+     * @brief Tear down the web view, keeping the session in a compact blob
+     *
+     * The document stays in C++, so text(), lines(), snapshot() and
+     * saving work as usual. Cursor, selections, scroll position, folds,
+     * undo history, options, markers and annotations are kept, highlight
+     * mode and theme are set again. Getters (selections(), selectedText(),
+     * isReadOnly(), isUndoAvailable() etc.) are answered from the kept
+     * state, annotations and markers are kept in C++ till then; editor is
+     * rehydrated, when it's shown or a call changes it. Visible editors
+     * and editors inside an open undo group are not hibernated.
+     * @see rehydrate(), setMemoryBudget()
+     */
+    void hibernate();
+
+    /**
+     * @brief Create web view again and restore the session
+     * @see hibernate()
+     */
+    void rehydrate();
+
+    /**
+     * @brief Suspend editor, when it's hidden or minimized (default)
+     *
+     * Suspended editor stops background tokenizer and cursor blinking, so
+     * hidden tabs cost no CPU. Everything continues at once, when it's
+     * shown again.
+     * @param enabled suspend or not?
+     */
+    void setSuspendWhenHidden(bool enabled);
+
+    /**
+     * @brief Configure background highlighting of the document
+     *
+     * Ace tokenizes lines in the same thread, which paints the editor:
+     * it works for @p budget milliseconds (checking time every
+     * @p rowsPerCheck rows) and sleeps for @p interval milliseconds.
+     * Defaults are 20, 20 and 5; e.g. 4 ms per 16 ms keeps 60 fps.
+     * @param budget time of a work chunk in milliseconds
+     * @param interval pause between chunks in milliseconds
+     * @param rowsPerCheck rows between time checks
+     */
+    void setTokenizationBudget(int budget, int interval = 20, int rowsPerCheck = 5);
+
+    /**
+     * @brief Stop background highlighting (e.g. during bulk loads)
+     *
+     * Visible lines are still highlighted on demand
+     * @see resumeTokenization()
+     */
+    void pauseTokenization();
+
+    /**
+     * @brief Continue background highlighting from where it stopped
+     * @see pauseTokenization()
+     */
+    void resumeTokenization();
+
+    /**
+     * @brief Move cursor to the bracket, matching the one near the cursor
+     * @see matchingBracket()
+     */
+    void jumpToMatchingBracket();
+
+    /**
+     * @brief Highlight matching brackets from the C++ index or by Ace
+     *
+     * Ace scans the document on each cursor move, what is slow for long
+     * blocks. Native matching paints markers of the "bracket" layer.
+     * @param enabled highlight by Novile or not?
+     * @see setMarkerStyle()
+     */
+    void setNativeBracketMatching(bool enabled);
+
     /**
      * @brief Set fold widgets fade or not?
      * @param is are they?
@@ -327,10 +885,42 @@ public slots:
 
     /**
      * @brief Set source code for editor
+     *
+     * Undo history is cleared and document is marked as unmodified
      * @param newText new source code
+     * @see setTextPreserving()
      */
     void setText(const QString &newText);
 
+    /**
+     * @brief Set source code, changing only lines, which differ
+     *
+     * New text is compared with the current one line by line, and only
+     * changed ranges are replaced in Ace (in one call, as one undo step).
+     * Unlike setText(), cursor, scroll position, folds, markers out of the
+     * changed lines, undo history and highlighting of other lines are kept.
+     * Good for results of formatters and code generators.
+     *
+     * Inside of an undo group, edits queued so far are applied before the
+     * comparison, so the group is undone in two steps: those edits and
+     * the rest of the group, including this call.
+     * @param newText new source code
+     * @see beginUndoGroup()
+     */
+    void setTextPreserving(const QString &newText);
+
+    /**
+     * @brief Set line ending style, used by text() and saveToFile()
+     * @param lineEnding style
+     */
+    void setLineEnding(LineEnding lineEnding);
+
+    /**
+     * @brief Mark document as modified or not
+     * @param modified is it?
+     */
+    void setModified(bool modified);
+
     /**
      * @brief Remove selected text from the editor
      */
@@ -400,8 +990,53 @@ public slots:
      */
     void setTheme(const QString &name);
 
+    /**
+     * @brief Replace all gutter annotations of the document
+     *
+     * Nothing is sent to Ace, if annotations are the same as before.
+     * @param annotations new annotations (e.g. compiler diagnostics)
+     */
+    void setAnnotations(const QVector<Annotation> &annotations);
+
+    /**
+     * @brief Remove all gutter annotations
+     */
+    void clearAnnotations();
+
+    /**
+     * @brief Replace all markers of the @p layer
+     *
+     * Only difference with the previous markers of the layer is sent to
+     * Ace, so it's cheap to call it with the same (or a bit changed) set.
+     * Markers are painted with CSS class "novile_$layer": "error",
+     * "warning" and "info" layers have predefined (underline) styles.
+     * @param layer name of the layer (letters, digits and "_" only)
+     * @param ranges new markers of the layer
+     * @see setMarkerStyle()
+     */
+    void setMarkers(const QString &layer, const QVector<Range> &ranges);
+
+    /**
+     * @brief Remove all markers of the @p layer
+     * @param layer name of the layer
+     */
+    void clearMarkers(const QString &layer);
+
+    /**
+     * @brief Set CSS style, used for markers of the @p layer
+     *
+     * Type affects markers, which are set after the call
+     * @param layer name of the layer
+     * @param css declarations, e.g. "background: rgba(255, 0, 0, 0.2);"
+     * @param type paint the text of ranges or whole lines
+     */
+    void setMarkerStyle(const QString &layer, const QString &css,
+                        MarkerType type = MarkerText);
+
 protected:
     bool eventFilter(QObject *object, QEvent *filteredEvent);
+    void showEvent(QShowEvent *event);
+    void hideEvent(QHideEvent *event);
 
 signals:
     /**
@@ -414,6 +1049,38 @@ signals:
      */
     void textChanged();
 
+    /**
+     * @brief Cursor has been moved to the new position
+     * @param row new cursor's line
+     * @param column new cursor's column
+     */
+    void cursorPositionChanged(int row, int column);
+
+    /**
+     * @brief Selection in the document has been changed
+     */
+    void selectionChanged();
+
+    /**
+     * @brief Editor has been scrolled
+     * @param row first visible line
+     */
+    void firstVisibleLineChanged(int row);
+
+    /**
+     * @brief Document became modified or unmodified
+     * @param modified is it?
+     */
+    void modificationChanged(bool modified);
+
+    /**
+     * @brief Background save has been finished
+     * @param fileName destination file
+     * @param success is file saved?
+     * @see saveToFile()
+     */
+    void saveFinished(const QString &fileName, bool success);
+
 private:
     EditorPrivate * const d;
 };
@@ -4,16 +4,51 @@
 #include <QtCore>
 #include <QVBoxLayout>
 
-#include <QtWebKit>
-#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
-#include <QtWebKitWidgets>
-#endif
-
+#include "novile_debug.h"
+#include "webbackend_p.h"
+#include "documentstore_p.h"
+#include "textfile_p.h"
+#include "folding_p.h"
+#include "bracketindex_p.h"
+#include "completionindex_p.h"
+#include "editlog_p.h"
+#include "viewstate_p.h"
 #include "editor.h"
+#include "editorsettings.h"
 
 namespace Novile
 {
 
+/**
+ * @brief The PreparedText struct
+ *
+ * New document, ready to be set into the editor. Everything expensive
+ * (decoding, splitting, escaping) is done while preparing, so it can be
+ * done in the worker thread.
+ */
+struct PreparedText
+{
+    PreparedText() :
+        lineEnding(Editor::LineEndingUnix),
+        encoding("UTF-8"),
+        byteOrderMark(false),
+        fromFile(false),
+        success(true)
+    {
+    }
+
+    QStringList lines;
+    Editor::LineEnding lineEnding;
+    QString escaped;
+    WordCounts words;
+
+    // Only for loaded files
+    QByteArray encoding;
+    bool byteOrderMark;
+    bool fromFile;
+    bool success;
+};
+
 /**
  * @brief The EditorPrivate class
  *
@@ -32,34 +67,354 @@ public:
     EditorPrivate(Editor *p = 0) :
         QObject(),
         parent(p),
-        aceView(new QWebView(p)),
-        layout(new QVBoxLayout(p))
+        web(WebBackend::create(p)),
+        layout(new QVBoxLayout(p)),
+        cursorRow(0),
+        cursorColumn(0),
+        firstVisibleRow(0),
+        undoGroupDepth(0),
+        savedVersion(0),
+        encoding("UTF-8"),
+        byteOrderMark(false),
+        nativeBracketMatching(false),
+        tokenizationPaused(false),
+        suspendWhenHidden(true),
+        suspended(false),
+        readOnly(false),
+        generation(0),
+        receivedDeltas(0),
+        awaitedDeltas(0),
+        deltaLoop(0)
     {
         parent->setLayout(layout);
-        layout->addWidget(aceView);
+        layout->addWidget(web->view());
         layout->setMargin(0);
 
-        aceView->installEventFilter(parent);
+        web->view()->installEventFilter(parent);
 
         connect(this, SIGNAL(linesChanged(int)),
                 parent, SIGNAL(linesChanged(int)));
 
         connect(this, SIGNAL(textChanged()),
                 parent, SIGNAL(textChanged()));
+
+        connect(this, SIGNAL(cursorPositionChanged(int,int)),
+                parent, SIGNAL(cursorPositionChanged(int,int)));
+
+        connect(this, SIGNAL(selectionChanged()),
+                parent, SIGNAL(selectionChanged()));
+
+        connect(this, SIGNAL(firstVisibleLineChanged(int)),
+                parent, SIGNAL(firstVisibleLineChanged(int)));
+
+        connect(this, SIGNAL(modificationChanged(bool)),
+                parent, SIGNAL(modificationChanged(bool)));
+
+        connect(this, SIGNAL(saveFinished(QString,bool)),
+                parent, SIGNAL(saveFinished(QString,bool)));
+
+        editors().prepend(this);
     }
 
     ~EditorPrivate()
     {
+        delete web;
+        editors().removeOne(this);
+
+        WordCounts removed;
+        WordCounts::const_iterator i = words.constBegin();
+        for (; i != words.constEnd(); ++i)
+            removed.insert(i.key(), -i.value());
+        CompletionIndex::instance()->update(removed);
+    }
+
+    /**
+     * @brief Run some JS code to Ace, without waiting for the result
+     * @param code javascript source
+     * @see evaluateJavaScript()
+     */
+    void executeJavaScript(const QString &code)
+    {
+        // Hibernated editor wakes up on demand
+        if (isHibernated())
+            rehydrate();
+
+        Q_ASSERT(web);
+        web->run(code);
     }
 
     /**
-     * @brief Run some JS code to Ace
+     * @brief Run some JS code to Ace and wait for the result
      * @param code javascript source
      * @return evaluation result
      */
-    QVariant executeJavaScript(const QString &code)
+    QVariant evaluateJavaScript(const QString &code)
+    {
+        if (isHibernated())
+            rehydrate();
+
+        Q_ASSERT(web);
+        return web->evaluate(code);
+    }
+
+    /**
+     * @brief Run editing JS code or queue it, if undo group is open
+     * @param code javascript source, which modifies the document
+     * @see Editor::beginUndoGroup()
+     */
+    void executeEdit(const QString &code)
+    {
+        if (undoGroupDepth > 0)
+            pendingEdits << code;
+        else
+            executeJavaScript(code);
+    }
+
+    /**
+     * @brief Apply edits, queued by the open undo group, as one undo step
+     * @see Editor::endUndoGroup()
+     */
+    void flushPendingEdits()
     {
-        return aceView->page()->mainFrame()->evaluateJavaScript(code);
+        if (pendingEdits.isEmpty())
+            return;
+
+        // Deltas of the whole group are merged into a single undo entry
+        // by closing undo groups around it: all edits land in one call
+        const QString request = ""
+                "editor.session.markUndoGroup();"
+                "%1;"
+                "editor.session.markUndoGroup();";
+        executeJavaScript(request.arg(pendingEdits.join(";")));
+        pendingEdits.clear();
+    }
+
+    /**
+     * @brief Split and escape @p text (thread-safe)
+     * @param text new document
+     * @return prepared document
+     */
+    static PreparedText prepareText(const QString &text)
+    {
+        PreparedText prepared;
+        prepared.lines = DocumentStore::splitLines(text, &prepared.lineEnding);
+        prepared.escaped = escape(text);
+        CompletionIndex::countWords(prepared.lines, 1, &prepared.words);
+        return prepared;
+    }
+
+    /**
+     * @brief Read, decode, split and escape the file (thread-safe)
+     * @param fileName source file
+     * @return prepared document (success is false, if file can't be read)
+     */
+    static PreparedText prepareFile(const QString &fileName)
+    {
+        QString text;
+        QByteArray encoding;
+        bool byteOrderMark = false;
+        if (!TextFile::read(fileName, &text, &encoding, &byteOrderMark)) {
+            PreparedText failed;
+            failed.fromFile = true;
+            failed.success = false;
+            return failed;
+        }
+
+        PreparedText prepared = prepareText(text);
+        prepared.encoding = encoding;
+        prepared.byteOrderMark = byteOrderMark;
+        prepared.fromFile = true;
+        return prepared;
+    }
+
+    /**
+     * @brief Set prepared document into the store and Ace
+     *
+     * Cursor is moved to the end, document is marked as unmodified
+     * @param prepared document
+     */
+    void applyText(const PreparedText &prepared)
+    {
+        if (!prepared.success)
+            return;
+
+        // Changes are not pushed back by wrapper.js: we already know them
+        store.setLines(prepared.lines, prepared.lineEnding);
+        brackets.invalidate();
+        log.reset(store.version());
+        setSavedVersion(store.version());
+
+        WordCounts change = prepared.words;
+        WordCounts::const_iterator i = words.constBegin();
+        for (; i != words.constEnd(); ++i)
+            change[i.key()] -= i.value();
+        CompletionIndex::instance()->update(change);
+        words = prepared.words;
+
+        if (prepared.fromFile) {
+            encoding = prepared.encoding;
+            byteOrderMark = prepared.byteOrderMark;
+        }
+
+        const int lastLine = store.lineCount() - 1;
+        const QString request = ""
+                "%1;"
+                "editor.moveCursorTo(%2, %3);";
+        executeJavaScript(request.arg(documentTextRequest(prepared.escaped),
+                                      QString::number(lastLine),
+                                      QString::number(store.line(lastLine).length())));
+    }
+
+    /**
+     * @brief Request, which replaces the whole document of the page
+     *
+     * New generation of the document begins: changes of the previous one,
+     * which are still on the way from the page, are dropped
+     * @param escaped text, escaped with escape()
+     * @return javascript request
+     */
+    QString documentTextRequest(const QString &escaped)
+    {
+        generation++;
+        receivedDeltas = 0;
+        return QString("setDocumentText('%1', %2)").arg(escaped, QString::number(generation));
+    }
+
+    /**
+     * @brief Wait for changes, which have been sent by the page, but
+     * haven't reached the store yet
+     *
+     * QtWebEngine delivers them asynchronously, with QtWebKit they are
+     * always delivered already. Call it before the store is compared to
+     * the page or the page is destroyed.
+     */
+    void waitForDeltas()
+    {
+        if (isHibernated())
+            return;
+
+        awaitedDeltas = evaluateJavaScript("sentDeltas").toInt();
+        if (receivedDeltas >= awaitedDeltas)
+            return;
+
+        QEventLoop loop;
+        QTimer::singleShot(DeltaTimeout, &loop, SLOT(quit()));
+        deltaLoop = &loop;
+        loop.exec(QEventLoop::ExcludeUserInputEvents);
+        deltaLoop = 0;
+
+        if (receivedDeltas < awaitedDeltas)
+            mDebug() << "Changes of the document haven't arrived from the page";
+    }
+
+    /**
+     * @brief Count the change, which has reached the store
+     * @see waitForDeltas()
+     */
+    void deltaReceived()
+    {
+        receivedDeltas++;
+        if (deltaLoop && receivedDeltas >= awaitedDeltas)
+            deltaLoop->quit();
+    }
+
+    /**
+     * @brief Apply difference of word counts to the document and completion index
+     * @param change difference (usually of changed lines only)
+     */
+    void updateWords(const WordCounts &change)
+    {
+        WordCounts::const_iterator i = change.constBegin();
+        for (; i != change.constEnd(); ++i) {
+            if (!i.value())
+                continue;
+
+            WordCounts::iterator word = words.find(i.key());
+            if (word == words.end())
+                words.insert(i.key(), i.value());
+            else if ((word.value() += i.value()) <= 0)
+                words.erase(word);
+        }
+        CompletionIndex::instance()->update(change);
+    }
+
+    /**
+     * @brief Suspend or resume background work of Ace
+     * @param value suspend or resume?
+     */
+    void setSuspended(bool value)
+    {
+        if (suspended == value)
+            return;
+
+        // Hibernated editor gets it on rehydration
+        suspended = value;
+        if (!isHibernated())
+            executeJavaScript(QString("setSuspended(%1)").arg(value));
+    }
+
+    /**
+     * @brief Find bracket near the cursor (before it first, as Ace does)
+     * @param column position of the found bracket (output)
+     * @param matchRow line of the matching bracket (output)
+     * @param matchColumn position of the matching bracket (output)
+     * @return is there a bracket with the match?
+     */
+    bool bracketNearCursor(int *column, int *matchRow, int *matchColumn)
+    {
+        for (int c = cursorColumn - 1; c <= cursorColumn; ++c) {
+            if (c >= 0 && brackets.matching(store, cursorRow, c, matchRow, matchColumn)) {
+                *column = c;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Mark bracket, matching the one near the cursor
+     */
+    void highlightBrackets()
+    {
+        QVector<Range> ranges;
+        int column, matchRow, matchColumn;
+        if (bracketNearCursor(&column, &matchRow, &matchColumn))
+            ranges << Range(matchRow, matchColumn, matchRow, matchColumn + 1);
+
+        parent->setMarkers("bracket", ranges);
+    }
+
+    /**
+     * @brief Queue document, which is being prepared in the background
+     * @param future preparation of the document
+     * @return future, which is finished, when document is set
+     */
+    QFuture<bool> queueText(const QFuture<PreparedText> &future)
+    {
+        PendingText pending;
+        pending.watcher = new QFutureWatcher<PreparedText>(this);
+        pending.result.reportStarted();
+        pendingTexts.enqueue(pending);
+
+        connect(pending.watcher, SIGNAL(finished()), this, SLOT(onTextPrepared()));
+        pending.watcher->setFuture(future);
+        return pending.result.future();
+    }
+
+    /**
+     * @brief Forget documents, which are still being prepared
+     *
+     * Their futures are canceled
+     */
+    void cancelPendingTexts()
+    {
+        while (!pendingTexts.isEmpty()) {
+            PendingText pending = pendingTexts.dequeue();
+            pending.watcher->disconnect(this);
+            pending.watcher->deleteLater();
+            pending.result.reportCanceled();
+            pending.result.reportFinished();
+        }
     }
 
     /**
@@ -67,37 +422,481 @@ public:
      */
     void startAceWidget()
     {
-        QEventLoop loop(parent);
+        QElapsedTimer timer;
+        timer.start();
 
-        QObject::connect(aceView, SIGNAL(loadFinished(bool)),
-                &loop, SLOT(quit()));
+        const bool connected = web->load(QUrl("qrc:/html/ace.html"), this);
 
-        aceView->load(QUrl("qrc:/html/ace.html"));
-        loop.exec();
+        // QtWebEngine receives input in a child widget of the view
+        if (QWidget *input = web->view()->focusProxy())
+            input->installEventFilter(parent);
 
         // Wrapper (data/wrapper.js)
-        QWebFrame *frame = aceView->page()->mainFrame();
-        frame->addToJavaScriptWindowObject("Novile", this);
-
         QFile listeners(":/html/wrapper.js");
         if (listeners.open(QIODevice::ReadOnly))
             executeJavaScript(listeners.readAll());
+
+        // Edits would never reach the document: don't let the user make them
+        if (!connected) {
+            readOnly = true;
+            executeJavaScript("editor.setReadOnly(true)");
+        }
+
+        mDebug() << "Ace widget has been started in" << timer.elapsed() << "ms";
+    }
+
+    /**
+     * @brief Is web view torn down?
+     * @return is it?
+     */
+    bool isHibernated() const
+    {
+        return !web;
+    }
+
+    /**
+     * @brief Keep session state in a compact blob and destroy the web view
+     * @see rehydrate()
+     */
+    void hibernate()
+    {
+        // Edits, queued by open undo group, need the page; shown editor
+        // would stay blank, because nothing rehydrates it
+        if (isHibernated() || undoGroupDepth > 0 || isShown())
+            return;
+
+        // Changes on the way would be lost with the page
+        waitForDeltas();
+        hibernatedView = viewState().save();
+        const QString state = evaluateJavaScript("getSessionState()").toString();
+        hibernatedState = qCompress(state.toUtf8());
+
+        layout->removeWidget(web->view());
+        delete web;
+        web = 0;
+
+        mDebug() << "Editor has been hibernated, session state takes"
+                 << hibernatedState.size() << "bytes";
+    }
+
+    /**
+     * @brief Create web view again and restore the session
+     * @see hibernate()
+     */
+    void rehydrate()
+    {
+        if (!isHibernated())
+            return;
+
+        web = WebBackend::create(parent);
+        layout->addWidget(web->view());
+        web->view()->installEventFilter(parent);
+        startAceWidget();
+
+        if (!modeRequest.isEmpty())
+            executeJavaScript(modeRequest);
+        if (!themeRequest.isEmpty())
+            executeJavaScript(themeRequest);
+
+        executeJavaScript(documentTextRequest(escape(store.text())));
+
+        const QString state = QString::fromUtf8(qUncompress(hibernatedState));
+        executeJavaScript(QString("restoreSessionState('%1')").arg(escape(state)));
+        executeJavaScript(settingsRequest(settings, EditorSettings::AllFields));
+        restoreViewState(hibernatedView);
+        hibernatedState.clear();
+        hibernatedView.clear();
+
+        // Diagnostics are sent again as a whole
+        const QVector<Annotation> sentAnnotations = annotations;
+        annotations.clear();
+        parent->setAnnotations(sentAnnotations);
+
+        const QHash<QString, QSet<Range> > sentMarkers = markerLayers;
+        markerLayers.clear();
+        QHash<QString, QSet<Range> >::const_iterator i = sentMarkers.constBegin();
+        for (; i != sentMarkers.constEnd(); ++i)
+            parent->setMarkers(i.key(), i.value().toList().toVector());
+
+        if (nativeBracketMatching)
+            executeJavaScript("setNativeBracketMatching(true)");
+        if (suspended)
+            executeJavaScript("setSuspended(true)");
+
+        // This editor is about to be used by the caller: it's never
+        // hibernated again right away, even if it's hidden
+        touch();
+        enforceMemoryBudget(this);
+    }
+
+    /**
+     * @brief Take view state of the page (one call)
+     * @return state with the fingerprint of the document
+     */
+    ViewState viewState()
+    {
+        ViewState state = ViewState::fromScript(evaluateJavaScript("getViewState()"));
+        state.document = ViewState::fingerprint(store.lines());
+        return state;
+    }
+
+    /**
+     * @brief View state, kept by the hibernated editor
+     *
+     * Getters read it instead of waking the editor up
+     * @return state (empty one, if there is no state)
+     */
+    ViewState hibernatedViewState() const
+    {
+        ViewState state;
+        state.load(hibernatedView);
+        return state;
+    }
+
+    /**
+     * @brief Text of the range from the store, lines are joined with "\n"
+     * like in Ace
+     * @param range text range
+     * @return text
+     */
+    QString textOf(const Range &range) const
+    {
+        if (range.startRow == range.endRow)
+            return store.line(range.startRow).mid(range.startColumn,
+                                                  range.endColumn - range.startColumn);
+
+        QStringList parts;
+        parts << store.line(range.startRow).mid(range.startColumn);
+        for (int row = range.startRow + 1; row < range.endRow; ++row)
+            parts << store.line(row);
+        parts << store.line(range.endRow).left(range.endColumn);
+        return parts.join("\n");
+    }
+
+    /**
+     * @brief Binary view state for Editor::saveState()
+     * @return blob
+     */
+    QByteArray saveViewState()
+    {
+        if (isHibernated())
+            return hibernatedView;
+
+        return viewState().save();
+    }
+
+    /**
+     * @brief Apply binary view state (one call)
+     * @param data blob, returned by saveViewState()
+     * @return is data valid?
+     */
+    bool restoreViewState(const QByteArray &data)
+    {
+        ViewState state;
+        if (!state.load(data))
+            return false;
+
+        // History of some other text would break the document
+        const ViewState::Fingerprint document = ViewState::fingerprint(store.lines());
+        const bool sameDocument = state.document == document;
+        if (!sameDocument) {
+            state.document = document;
+            state.folds.clear();
+            state.foldPlaceholders.clear();
+            state.undo.clear();
+            state.redo.clear();
+        }
+
+        if (isHibernated()) {
+            hibernatedView = sameDocument ? data : state.save();
+            return true;
+        }
+
+        executeJavaScript(QString("restoreViewState('%1')").arg(escape(state.toScript())));
+        return true;
+    }
+
+    /**
+     * @brief Rough estimate of memory, taken by the editor
+     * @return bytes
+     */
+    qint64 estimatedMemory() const
+    {
+        const qint64 text = store.characterCount() * sizeof(QChar);
+
+        if (isHibernated())
+            return text + hibernatedState.size() + hibernatedView.size();
+
+        // Ace keeps lines, tokens and render caches: several copies of the text
+        return PageMemory + text * (1 + AceMemoryFactor);
+    }
+
+    /**
+     * @brief Is editor on the screen (visible and not minimized)?
+     * @return is it?
+     */
+    bool isShown() const
+    {
+        return parent->isVisible() && !parent->window()->isMinimized();
+    }
+
+    /**
+     * @brief Mark editor as the most recently used one
+     */
+    void touch()
+    {
+        if (editors().first() != this) {
+            editors().removeOne(this);
+            editors().prepend(this);
+        }
+    }
+
+    /**
+     * @brief Hibernate hidden editors (the least recently used first),
+     * until all of them fit into the budget
+     * @param keep editor, which is never hibernated (e.g. just rehydrated one)
+     * @see Editor::setMemoryBudget()
+     */
+    static void enforceMemoryBudget(const EditorPrivate *keep = 0)
+    {
+        if (memoryBudget() <= 0)
+            return;
+
+        qint64 total = 0;
+        foreach (const EditorPrivate *editor, editors())
+            total += editor->estimatedMemory();
+
+        for (int i = editors().size() - 1; i >= 0 && total > memoryBudget(); --i) {
+            EditorPrivate *editor = editors().at(i);
+            if (editor == keep || editor->isHibernated() || editor->isShown())
+                continue;
+
+            total -= editor->estimatedMemory();
+            editor->hibernate();
+            total += editor->estimatedMemory();
+        }
+    }
+
+    /**
+     * @brief All editors of the process, the most recently used first
+     */
+    static QList<EditorPrivate *> &editors()
+    {
+        static QList<EditorPrivate *> list;
+        return list;
+    }
+
+    /**
+     * @brief Memory budget of all editors (0 means unlimited)
+     * @see Editor::setMemoryBudget()
+     */
+    static qint64 &memoryBudget()
+    {
+        static qint64 budget = 0;
+        return budget;
+    }
+
+    /**
+     * @brief Has document been changed since it was saved?
+     * @return is it?
+     */
+    bool isModified() const
+    {
+        return store.version() != savedVersion;
+    }
+
+    /**
+     * @brief Remember @p version as saved one, emit modificationChanged() if needed
+     * @param version version of the document (-1 means "never saved")
+     */
+    void setSavedVersion(int version)
+    {
+        const bool wasModified = isModified();
+        savedVersion = version;
+        if (wasModified != isModified())
+            emit modificationChanged(!wasModified);
+    }
+
+    /**
+     * @brief Directories, where mode and theme bundles are looked for
+     * @return list of directories (can be extended)
+     * @see Editor::addBundlePath()
+     */
+    static QStringList &bundlePaths()
+    {
+        static QStringList paths;
+        if (paths.isEmpty()) {
+            const QString fromEnvironment = QString::fromLocal8Bit(qgetenv("NOVILE_BUNDLE_PATH"));
+            if (!fromEnvironment.isEmpty())
+                paths << fromEnvironment.split(QDir::listSeparator());
+
+            // Build tree layout: <build>/example/app, <build>/share/novile
+            paths << QCoreApplication::applicationDirPath() + "/../share/novile";
+#ifdef NOVILE_BUNDLE_DIR
+            paths << QString(NOVILE_BUNDLE_DIR);
+#endif
+        }
+        return paths;
+    }
+
+    /**
+     * @brief Request, which sets options of Ace for the fields of @p settings
+     * in one call (theme is set by themeRequest)
+     * @param settings settings to take values from
+     * @param fields fields to set
+     * @return javascript code (empty, if there is nothing to set)
+     */
+    static QString settingsRequest(const EditorSettings &settings, EditorSettings::Fields fields)
+    {
+        QStringList options;
+        if (fields & EditorSettings::FontSize)
+            options << QString("fontSize: %1").arg(settings.fontSize());
+        if (fields & EditorSettings::GutterShown)
+            options << QString("showGutter: %1").arg(boolean(settings.isGutterShown()));
+        if (fields & EditorSettings::IndentationShown)
+            options << QString("displayIndentGuides: %1").arg(boolean(settings.isIndentationShown()));
+        if (fields & EditorSettings::InvisiblesShown)
+            options << QString("showInvisibles: %1").arg(boolean(settings.isInvisiblesShown()));
+        if (fields & EditorSettings::FadeFoldMarker)
+            options << QString("fadeFoldWidgets: %1").arg(boolean(settings.isFadeFoldMarker()));
+        if (fields & EditorSettings::PrintMarginShown)
+            options << QString("showPrintMargin: %1").arg(boolean(settings.isPrintMarginShown()));
+        if (fields & EditorSettings::HighlightSelectedWord)
+            options << QString("highlightSelectedWord: %1").arg(boolean(settings.isHighlightSelectedWord()));
+        if (fields & EditorSettings::ActiveLineHighlighted)
+            options << QString("highlightActiveLine: %1").arg(boolean(settings.isActiveLineHighlighted()));
+
+        if (options.isEmpty())
+            return QString();
+
+        return QString("editor.setOptions({%1});").arg(options.join(", "));
+    }
+
+    /**
+     * @brief Request, which loads and sets built-in theme
+     * @param name string, set into "ace/theme/$name"
+     * @return javascript code
+     */
+    static QString builtinThemeRequest(const QString &name)
+    {
+        ensureResource("ace/theme-" + name + ".js");
+
+        const QString request = ""
+                "if (loadScript('%1'))"
+                "    editor.setTheme('ace/theme/%2');";
+        return request.arg("qrc:/ace/theme-"+name+".js").arg(name);
+    }
+
+    /**
+     * @brief Apply changed @p fields of the settings in one call
+     *
+     * Hibernated editor only keeps them, they are set when it's rehydrated
+     * @param newSettings settings to take values from
+     * @param fields fields to apply (only the changed ones are sent)
+     * @see Editor::applySettings()
+     */
+    void applySettings(const EditorSettings &newSettings, EditorSettings::Fields fields)
+    {
+        fields &= newSettings.difference(settings);
+        if (!fields)
+            return;
+
+        settings.update(newSettings, fields);
+
+        QString request = settingsRequest(settings, fields);
+        if ((fields & EditorSettings::Theme) && !settings.theme().isEmpty()) {
+            themeRequest = builtinThemeRequest(settings.theme());
+            request += themeRequest;
+        }
+
+        if (!isHibernated() && !request.isEmpty())
+            executeJavaScript(request);
+    }
+
+    /**
+     * @brief Javascript literal of the boolean
+     * @param value boolean
+     * @return "true" or "false"
+     */
+    static QString boolean(bool value)
+    {
+        return value ? "true" : "false";
+    }
+
+    /**
+     * @brief Make @p script available in the resources
+     *
+     * Every mode and theme can be shipped as separate bundle (e.g.
+     * mode-c_cpp.rcc), so it's registered only when it's needed first time.
+     * Scripts, embedded into the library, are available without bundles.
+     * @param script resource path, e.g. "ace/mode-c_cpp.js"
+     * @return is script available or not
+     */
+    static bool ensureResource(const QString &script)
+    {
+        if (QFile::exists(":/" + script))
+            return true;
+
+        const QString bundle = QFileInfo(script).completeBaseName() + ".rcc";
+        foreach (const QString &path, bundlePaths()) {
+            const QString fileName = QDir(path).filePath(bundle);
+            if (QFile::exists(fileName) && QResource::registerResource(fileName)) {
+                mDebug() << "Bundle" << fileName << "has been registered";
+                return true;
+            }
+        }
+
+        mDebug() << "No bundle has been found for" << script;
+        return false;
     }
 
     /**
      * @brief Escape symbols for JavaScript calls
+     *
+     * It's done in a single pass; every line ending becomes "\n" (Ace
+     * doesn't need original ones: they are kept by DocumentStore).
      * @param text non-escaped code
      * @return escaped code (ready for js call)
      */
-    QString escape(const QString &text)
+    static QString escape(const QString &text)
     {
-        QString escaped = text;
-        escaped.replace("\r\n", "\n");
-        escaped.replace("\r", "\n");
-        escaped.replace("\n", "\\n");
-        escaped.replace("\t", "\\t");
-        escaped.replace("\'", "\\'");
-        escaped.replace("\"", "\\\"");
+        const QChar *data = text.constData();
+        const int size = text.size();
+
+        QString escaped;
+        escaped.reserve(size + size / 8 + 16);
+        for (int i = 0; i < size; ++i) {
+            const ushort c = data[i].unicode();
+            switch (c) {
+            case '\r':
+                if (i + 1 < size && data[i + 1].unicode() == '\n')
+                    ++i;
+                // fall through
+            case '\n':
+                escaped += QLatin1String("\\n");
+                break;
+            case '\t':
+                escaped += QLatin1String("\\t");
+                break;
+            case '\\':
+                escaped += QLatin1String("\\\\");
+                break;
+            case '\'':
+                escaped += QLatin1String("\\'");
+                break;
+            case '"':
+                escaped += QLatin1String("\\\"");
+                break;
+            case 0x2028:
+                escaped += QLatin1String("\\u2028");
+                break;
+            case 0x2029:
+                escaped += QLatin1String("\\u2029");
+                break;
+            default:
+                escaped += data[i];
+            }
+        }
 
         return escaped;
     }
@@ -122,6 +921,166 @@ public slots:
         emit textChanged();
     }
 
+    /**
+     * @brief Provider for cursorPositionChanged(), caches the new position
+     * @param row new cursor's line
+     * @param column new cursor's column
+     * @see cursorPositionChanged()
+     */
+    void onCursorPositionChanged(int row, int column)
+    {
+        if (row == cursorRow && column == cursorColumn)
+            return;
+
+        cursorRow = row;
+        cursorColumn = column;
+        emit cursorPositionChanged(row, column);
+
+        if (nativeBracketMatching)
+            highlightBrackets();
+    }
+
+    /**
+     * @brief Words for the completion popup of wrapper.js, which are sent
+     * back to openCompletions() (calls from the page may be asynchronous)
+     * @param prefix word before the cursor
+     */
+    void requestCompletions(const QString &prefix)
+    {
+        QStringList words;
+        foreach (const QString &word, CompletionIndex::instance()->complete(prefix, 50))
+            words << "'" + escape(word) + "'";
+
+        const QString request = "openCompletions('%1', [%2])";
+        executeJavaScript(request.arg(escape(prefix), words.join(",")));
+    }
+
+    /**
+     * @brief Provider for selectionChanged()
+     * @see selectionChanged()
+     */
+    void onSelectionChanged()
+    {
+        emit selectionChanged();
+    }
+
+    /**
+     * @brief Provider for firstVisibleLineChanged(), caches the row
+     * @param row first visible line
+     * @see firstVisibleLineChanged()
+     */
+    void onFirstVisibleLineChanged(int row)
+    {
+        firstVisibleRow = row;
+        emit firstVisibleLineChanged(row);
+    }
+
+    /**
+     * @brief Text has been inserted into Ace document: update the copy
+     * @param documentGeneration generation of the changed document
+     * @param row coordinates: line
+     * @param column coordinates: position from the left
+     * @param text inserted text
+     */
+    void onDocumentInsert(int documentGeneration, int row, int column, const QString &text)
+    {
+        // Change of the replaced document, which was still on the way
+        if (documentGeneration != generation)
+            return;
+        deltaReceived();
+
+        const int newCount = text.count(QLatin1Char('\n')) + 1;
+
+        WordCounts change;
+        CompletionIndex::countWords(store.line(row), -1, &change);
+
+        const bool wasModified = isModified();
+        store.insert(row, column, text);
+        log.append(Range(row, column, row, column), text, store.version());
+        brackets.replaceLines(store, row, 1, newCount);
+
+        CompletionIndex::countWords(store.lines().mid(row, newCount), 1, &change);
+        updateWords(change);
+        if (!wasModified && isModified())
+            emit modificationChanged(true);
+    }
+
+    /**
+     * @brief Text has been removed from Ace document: update the copy
+     * @param documentGeneration generation of the changed document
+     * @param startRow first line
+     * @param startColumn position in the first line
+     * @param endRow last line
+     * @param endColumn position in the last line
+     */
+    void onDocumentRemove(int documentGeneration, int startRow, int startColumn,
+                          int endRow, int endColumn)
+    {
+        if (documentGeneration != generation)
+            return;
+        deltaReceived();
+
+        WordCounts change;
+        CompletionIndex::countWords(store.lines().mid(startRow, endRow - startRow + 1), -1, &change);
+
+        const bool wasModified = isModified();
+        store.remove(startRow, startColumn, endRow, endColumn);
+        log.append(Range(startRow, startColumn, endRow, endColumn), QString(), store.version());
+        brackets.replaceLines(store, startRow, endRow - startRow + 1, 1);
+
+        CompletionIndex::countWords(store.line(startRow), 1, &change);
+        updateWords(change);
+        if (!wasModified && isModified())
+            emit modificationChanged(true);
+    }
+
+    /**
+     * @brief Some of the queued documents have been prepared
+     *
+     * Documents are set strictly in order of the calls
+     * @see queueText()
+     */
+    void onTextPrepared()
+    {
+        while (!pendingTexts.isEmpty() && pendingTexts.head().watcher->isFinished()) {
+            PendingText pending = pendingTexts.dequeue();
+            const PreparedText prepared = pending.watcher->result();
+            pending.watcher->deleteLater();
+
+            applyText(prepared);
+            pending.result.reportResult(prepared.success);
+            pending.result.reportFinished();
+        }
+    }
+
+    /**
+     * @brief Fold ranges requested by Editor::updateFoldRanges() are ready
+     */
+    void onFoldRangesComputed()
+    {
+        QFutureWatcher<QVector<Range> > *watcher =
+                static_cast<QFutureWatcher<QVector<Range> > *>(sender());
+        parent->setFoldRanges(watcher->result());
+        watcher->deleteLater();
+    }
+
+    /**
+     * @brief Background save has been finished
+     * @see Editor::saveToFile()
+     */
+    void onSaveFinished()
+    {
+        QFutureWatcher<bool> *watcher = static_cast<QFutureWatcher<bool> *>(sender());
+        const QString fileName = watcher->property("fileName").toString();
+        const bool success = watcher->result();
+
+        if (success)
+            setSavedVersion(watcher->property("version").toInt());
+
+        emit saveFinished(fileName, success);
+        watcher->deleteLater();
+    }
+
 signals:
     /**
      * @brief Intermediate signal for Editor::linesChanged()
@@ -135,10 +1094,112 @@ signals:
      */
     void textChanged();
 
+    /**
+     * @brief Intermediate signal for Editor::cursorPositionChanged()
+     * @see Editor::cursorPositionChanged()
+     */
+    void cursorPositionChanged(int, int);
+
+    /**
+     * @brief Intermediate signal for Editor::selectionChanged()
+     * @see Editor::selectionChanged()
+     */
+    void selectionChanged();
+
+    /**
+     * @brief Intermediate signal for Editor::firstVisibleLineChanged()
+     * @see Editor::firstVisibleLineChanged()
+     */
+    void firstVisibleLineChanged(int row);
+
+    /**
+     * @brief Intermediate signal for Editor::modificationChanged()
+     * @see Editor::modificationChanged()
+     */
+    void modificationChanged(bool);
+
+    /**
+     * @brief Intermediate signal for Editor::saveFinished()
+     * @see Editor::saveFinished()
+     */
+    void saveFinished(const QString &, bool);
+
 public:
     Editor *parent;
-    QWebView *aceView;
+    WebBackend *web;
     QVBoxLayout *layout;
+
+    // Cursor position, pushed by wrapper.js on each move
+    int cursorRow;
+    int cursorColumn;
+
+    // Scroll position, pushed by wrapper.js
+    int firstVisibleRow;
+
+    // Edits, queued by open undo group(s)
+    int undoGroupDepth;
+    QStringList pendingEdits;
+
+    // What has been sent to Ace: diagnostics are diffed against it
+    QVector<Annotation> annotations;
+    QHash<QString, QSet<Range> > markerLayers;
+
+    // C++ copy of the document and version, which was saved last time
+    DocumentStore store;
+    int savedVersion;
+
+    // Generation of the document, set as a whole, and count of its changes,
+    // which have reached the store (see setDocumentText() in wrapper.js)
+    int generation;
+    int receivedDeltas;
+    int awaitedDeltas;
+    QEventLoop *deltaLoop;
+    enum { DeltaTimeout = 5000 };
+
+    // Last changes of the store for Editor::changesSince()
+    EditLog log;
+
+    // Brackets of the store, updated with changed lines
+    BracketIndex brackets;
+    bool nativeBracketMatching;
+
+    // Background tokenizer is paused by Editor::pauseTokenization()
+    bool tokenizationPaused;
+
+    // Hidden editor stops working in the background
+    bool suspendWhenHidden;
+    bool suspended;
+
+    // Set by Editor::setReadOnly(), so it's known without the page
+    bool readOnly;
+
+    // Visual options, which have been applied (see Editor::applySettings())
+    EditorSettings settings;
+
+    // Hibernation: compressed settings of the page (see getSessionState()
+    // in wrapper.js), view state and requests, which set mode and theme
+    QByteArray hibernatedState;
+    QByteArray hibernatedView;
+    QString modeRequest;
+    QString themeRequest;
+
+    // Estimate of memory: web page itself and Ace's copies of the text
+    enum { PageMemory = 12 * 1024 * 1024, AceMemoryFactor = 8 };
+
+    // Words of the document, which are in the completion index
+    WordCounts words;
+
+    // Encoding of the file, document was loaded from (used for saving)
+    QByteArray encoding;
+    bool byteOrderMark;
+
+    // Documents, which are prepared in the background (see setTextAsync())
+    struct PendingText
+    {
+        QFutureWatcher<PreparedText> *watcher;
+        QFutureInterface<bool> result;
+    };
+    QQueue<PendingText> pendingTexts;
 };
 
 } // namespace Novile
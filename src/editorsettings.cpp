@@ -0,0 +1,197 @@
+/*
+ * This file is part of the Novile Editor
+ * This program is free software licensed under the GNU LGPL. You can
+ * find a copy of this license in LICENSE in the top directory of
+ * the source code.
+ *
+ * Copyright 2013    Illya Kovalevskyy   <illya.kovalevskyy@gmail.com>
+ *
+ */
+
+#include "editorsettings.h"
+#include "editor_p.h"
+
+namespace Novile
+{
+
+Q_GLOBAL_STATIC(EditorSettings, defaults)
+
+EditorSettings::EditorSettings() :
+    m_fontSize(12),
+    m_gutterShown(true),
+    m_indentationShown(true),
+    m_invisiblesShown(false),
+    m_fadeFoldMarker(false),
+    m_printMarginShown(true),
+    m_highlightSelectedWord(true),
+    m_activeLineHighlighted(true)
+{
+}
+
+int EditorSettings::fontSize() const
+{
+    return m_fontSize;
+}
+
+void EditorSettings::setFontSize(int px)
+{
+    m_fontSize = px;
+}
+
+QString EditorSettings::theme() const
+{
+    return m_theme;
+}
+
+void EditorSettings::setTheme(const QString &name)
+{
+    m_theme = name;
+}
+
+bool EditorSettings::isGutterShown() const
+{
+    return m_gutterShown;
+}
+
+void EditorSettings::setGutterShown(bool is)
+{
+    m_gutterShown = is;
+}
+
+bool EditorSettings::isIndentationShown() const
+{
+    return m_indentationShown;
+}
+
+void EditorSettings::setIndentationShown(bool is)
+{
+    m_indentationShown = is;
+}
+
+bool EditorSettings::isInvisiblesShown() const
+{
+    return m_invisiblesShown;
+}
+
+void EditorSettings::setInvisiblesShown(bool is)
+{
+    m_invisiblesShown = is;
+}
+
+bool EditorSettings::isFadeFoldMarker() const
+{
+    return m_fadeFoldMarker;
+}
+
+void EditorSettings::setFadeFoldMarker(bool is)
+{
+    m_fadeFoldMarker = is;
+}
+
+bool EditorSettings::isPrintMarginShown() const
+{
+    return m_printMarginShown;
+}
+
+void EditorSettings::setPrintMarginShown(bool is)
+{
+    m_printMarginShown = is;
+}
+
+bool EditorSettings::isHighlightSelectedWord() const
+{
+    return m_highlightSelectedWord;
+}
+
+void EditorSettings::setHighlightSelectedWord(bool is)
+{
+    m_highlightSelectedWord = is;
+}
+
+bool EditorSettings::isActiveLineHighlighted() const
+{
+    return m_activeLineHighlighted;
+}
+
+void EditorSettings::setActiveLineHighlighted(bool is)
+{
+    m_activeLineHighlighted = is;
+}
+
+EditorSettings::Fields EditorSettings::difference(const EditorSettings &other) const
+{
+    Fields fields;
+    if (m_fontSize != other.m_fontSize)
+        fields |= FontSize;
+    if (m_theme != other.m_theme)
+        fields |= Theme;
+    if (m_gutterShown != other.m_gutterShown)
+        fields |= GutterShown;
+    if (m_indentationShown != other.m_indentationShown)
+        fields |= IndentationShown;
+    if (m_invisiblesShown != other.m_invisiblesShown)
+        fields |= InvisiblesShown;
+    if (m_fadeFoldMarker != other.m_fadeFoldMarker)
+        fields |= FadeFoldMarker;
+    if (m_printMarginShown != other.m_printMarginShown)
+        fields |= PrintMarginShown;
+    if (m_highlightSelectedWord != other.m_highlightSelectedWord)
+        fields |= HighlightSelectedWord;
+    if (m_activeLineHighlighted != other.m_activeLineHighlighted)
+        fields |= ActiveLineHighlighted;
+    return fields;
+}
+
+void EditorSettings::update(const EditorSettings &other, Fields fields)
+{
+    if (fields & FontSize)
+        m_fontSize = other.m_fontSize;
+    if (fields & Theme)
+        m_theme = other.m_theme;
+    if (fields & GutterShown)
+        m_gutterShown = other.m_gutterShown;
+    if (fields & IndentationShown)
+        m_indentationShown = other.m_indentationShown;
+    if (fields & InvisiblesShown)
+        m_invisiblesShown = other.m_invisiblesShown;
+    if (fields & FadeFoldMarker)
+        m_fadeFoldMarker = other.m_fadeFoldMarker;
+    if (fields & PrintMarginShown)
+        m_printMarginShown = other.m_printMarginShown;
+    if (fields & HighlightSelectedWord)
+        m_highlightSelectedWord = other.m_highlightSelectedWord;
+    if (fields & ActiveLineHighlighted)
+        m_activeLineHighlighted = other.m_activeLineHighlighted;
+}
+
+bool EditorSettings::operator==(const EditorSettings &other) const
+{
+    return !difference(other);
+}
+
+bool EditorSettings::operator!=(const EditorSettings &other) const
+{
+    return !(*this == other);
+}
+
+EditorSettings EditorSettings::defaultSettings()
+{
+    return *defaults();
+}
+
+void EditorSettings::setDefault(const EditorSettings &settings)
+{
+    const EditorSettings old = *defaults();
+    const Fields changed = settings.difference(old);
+    *defaults() = settings;
+    if (!changed)
+        return;
+
+    // Only fields, which still have the old default value in the editor
+    foreach (EditorPrivate *editor, EditorPrivate::editors()) {
+        const Fields own = editor->settings.difference(old);
+        editor->applySettings(settings, changed & ~own);
+    }
+}
+
+} // namespace Novile
@@ -0,0 +1,219 @@
+/*
+ * This file is part of the Novile Editor
+ * This program is free software licensed under the GNU LGPL. You can
+ * find a copy of this license in LICENSE in the top directory of
+ * the source code.
+ *
+ * Copyright 2013    Illya Kovalevskyy   <illya.kovalevskyy@gmail.com>
+ *
+ */
+
+#ifndef EDITORSETTINGS_H
+#define EDITORSETTINGS_H
+
+#include <QtCore/QFlags>
+#include <QtCore/QString>
+#include <QtCore/QMetaType>
+#include "novile_export.h"
+
+namespace Novile
+{
+
+/**
+ * @brief The EditorSettings class
+ *
+ * Visual options of the editor as a value: font size, theme, gutter,
+ * guides, invisibles, fold widgets, print margin and highlights. Editor
+ * keeps the settings it has applied, so reading them costs no calls to
+ * the page, and applying them sends only the changed fields at once.
+ *
+ * Default settings are applied to new editors, setDefault() also updates
+ * every live editor (user preferences have been changed).
+ * @see Editor::applySettings()
+ */
+class NOVILE_EXPORT EditorSettings
+{
+public:
+    /**
+     * @brief Fields of the settings
+     */
+    enum Field {
+        FontSize = 0x1,
+        Theme = 0x2,
+        GutterShown = 0x4,
+        IndentationShown = 0x8,
+        InvisiblesShown = 0x10,
+        FadeFoldMarker = 0x20,
+        PrintMarginShown = 0x40,
+        HighlightSelectedWord = 0x80,
+        ActiveLineHighlighted = 0x100,
+        AllFields = 0x1ff
+    };
+    Q_DECLARE_FLAGS(Fields, Field)
+
+    /**
+     * @brief Settings of Ace itself: 12px, default theme, everything is
+     * shown and highlighted, invisibles are hidden, fold widgets don't fade
+     */
+    EditorSettings();
+
+    /**
+     * @brief Font size of the source text
+     * @return size in pixels
+     */
+    int fontSize() const;
+
+    /**
+     * @brief Set font size of the source text
+     * @param px size in pixels
+     */
+    void setFontSize(int px);
+
+    /**
+     * @brief Name of the built-in theme ("ace/theme/$name")
+     * @return name (empty means the theme isn't changed)
+     */
+    QString theme() const;
+
+    /**
+     * @brief Set built-in theme
+     * @param name string, set into "ace/theme/$name"
+     */
+    void setTheme(const QString &name);
+
+    /**
+     * @brief Is left margin (line numbers) shown?
+     * @return is it?
+     */
+    bool isGutterShown() const;
+
+    /**
+     * @brief Set left margin (line numbers) shown
+     * @param is is it?
+     */
+    void setGutterShown(bool is);
+
+    /**
+     * @brief Are indentation guides shown?
+     * @return are they?
+     */
+    bool isIndentationShown() const;
+
+    /**
+     * @brief Set indentation guides shown or not
+     * @param is are they?
+     */
+    void setIndentationShown(bool is);
+
+    /**
+     * @brief Are invisible symbols shown?
+     * @return are they?
+     */
+    bool isInvisiblesShown() const;
+
+    /**
+     * @brief Set invisible symbols shown or not
+     * @param is are they?
+     */
+    void setInvisiblesShown(bool is);
+
+    /**
+     * @brief Are fold widgets visible only on hover?
+     * @return are they?
+     */
+    bool isFadeFoldMarker() const;
+
+    /**
+     * @brief Set fold widgets fade or not
+     * @param is are they?
+     */
+    void setFadeFoldMarker(bool is);
+
+    /**
+     * @brief Is print margin (semi-transparent line at right) shown?
+     * @return is it?
+     */
+    bool isPrintMarginShown() const;
+
+    /**
+     * @brief Set print margin shown or not
+     * @param is is it?
+     */
+    void setPrintMarginShown(bool is);
+
+    /**
+     * @brief Is current word highlighted with a rect?
+     * @return is it?
+     */
+    bool isHighlightSelectedWord() const;
+
+    /**
+     * @brief Set current word highlighted with a rect
+     * @param is is it?
+     */
+    void setHighlightSelectedWord(bool is);
+
+    /**
+     * @brief Is current line highlighted?
+     * @return is it?
+     */
+    bool isActiveLineHighlighted() const;
+
+    /**
+     * @brief Set current line highlighted
+     * @param is is it?
+     */
+    void setActiveLineHighlighted(bool is);
+
+    /**
+     * @brief Fields, which differ from the @p other settings
+     * @param other settings to compare with
+     * @return changed fields
+     */
+    Fields difference(const EditorSettings &other) const;
+
+    /**
+     * @brief Take some fields from the @p other settings
+     * @param other settings to take fields from
+     * @param fields fields to take
+     */
+    void update(const EditorSettings &other, Fields fields);
+
+    bool operator==(const EditorSettings &other) const;
+    bool operator!=(const EditorSettings &other) const;
+
+    /**
+     * @brief Settings, new editors start with
+     * @return settings
+     */
+    static EditorSettings defaultSettings();
+
+    /**
+     * @brief Change default settings and apply the changed fields to every
+     * live editor
+     *
+     * A changed field is applied only to editors, where it still has the
+     * old default value, so options, set for some editor only, stay.
+     * Hibernated editors only keep the settings until they are rehydrated.
+     * @param settings new defaults
+     */
+    static void setDefault(const EditorSettings &settings);
+
+private:
+    int m_fontSize;
+    QString m_theme;
+    bool m_gutterShown;
+    bool m_indentationShown;
+    bool m_invisiblesShown;
+    bool m_fadeFoldMarker;
+    bool m_printMarginShown;
+    bool m_highlightSelectedWord;
+    bool m_activeLineHighlighted;
+};
+
+} // namespace Novile
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(Novile::EditorSettings::Fields)
+Q_DECLARE_METATYPE(Novile::EditorSettings)
+
+#endif // EDITORSETTINGS_H
@@ -0,0 +1,166 @@
+/*
+ * This file is part of the Novile Editor
+ * This program is free software licensed under the GNU LGPL. You can
+ * find a copy of this license in LICENSE in the top directory of
+ * the source code.
+ *
+ * Copyright 2013    Illya Kovalevskyy   <illya.kovalevskyy@gmail.com>
+ *
+ */
+
+#include <algorithm>
+
+#include <QtCore/QHash>
+#include <QtCore/QPair>
+#include <QtCore/QStack>
+
+#include "folding_p.h"
+
+namespace Novile
+{
+
+namespace Folding
+{
+
+struct Bracket
+{
+    ushort symbol;
+    int row;
+    int column;
+};
+
+static bool startsEarlier(const Range &first, const Range &second)
+{
+    return first.startRow < second.startRow;
+}
+
+/**
+ * @brief Indentation width of the @p line, -1 for blank lines
+ */
+static int indentation(const QString &line, int tabSize)
+{
+    int width = 0;
+    const int size = line.size();
+    for (int i = 0; i < size; ++i) {
+        const QChar c = line.at(i);
+        if (c == QLatin1Char(' '))
+            width++;
+        else if (c == QLatin1Char('\t'))
+            width += tabSize - width % tabSize;
+        else
+            return width;
+    }
+    return -1;
+}
+
+QVector<Range> byIndentation(const QStringList &lines, int tabSize)
+{
+    QVector<Range> ranges;
+
+    // Rows, which can start a block, with their indentation
+    QStack<QPair<int, int> > open;
+    int lastNonBlank = -1;
+
+    for (int row = 0; row <= lines.size(); ++row) {
+        // Extra iteration closes everything at the end of the document
+        const int indent = row < lines.size() ? indentation(lines.at(row), tabSize) : 0;
+        if (indent < 0)
+            continue;
+
+        while (!open.isEmpty() && open.top().second >= indent) {
+            const int start = open.pop().first;
+            if (lastNonBlank > start) {
+                ranges << Range(start, lines.at(start).length(),
+                                lastNonBlank, lines.at(lastNonBlank).length());
+            }
+        }
+
+        if (row < lines.size()) {
+            open.push(qMakePair(row, indent));
+            lastNonBlank = row;
+        }
+    }
+
+    std::sort(ranges.begin(), ranges.end(), startsEarlier);
+    return ranges;
+}
+
+QVector<Range> byBrackets(const QStringList &lines)
+{
+    QVector<Range> ranges;
+    QHash<int, int> rangeByRow;
+    QVector<Bracket> open;
+
+    for (int row = 0; row < lines.size(); ++row) {
+        const QString &line = lines.at(row);
+        const QChar *data = line.constData();
+        const int size = line.size();
+
+        ushort quote = 0;
+        for (int column = 0; column < size; ++column) {
+            const ushort c = data[column].unicode();
+
+            if (quote) {
+                if (c == '\\')
+                    ++column;
+                else if (c == quote)
+                    quote = 0;
+                continue;
+            }
+
+            switch (c) {
+            case '"':
+            case '\'':
+                quote = c;
+                break;
+            case '{':
+            case '[':
+            case '(': {
+                Bracket bracket = { c, row, column };
+                open << bracket;
+                break;
+            }
+            case '}':
+            case ']':
+            case ')': {
+                const ushort expected = c == '}' ? '{' : (c == ']' ? '[' : '(');
+                if (open.isEmpty() || open.last().symbol != expected)
+                    break; // unbalanced, leave the stack as is
+
+                const Bracket bracket = open.last();
+                open.pop_back();
+                if (bracket.row == row)
+                    break;
+
+                // The largest range wins for each start row
+                const Range range(bracket.row, bracket.column + 1, row, column);
+                const int index = rangeByRow.value(bracket.row, -1);
+                if (index < 0) {
+                    rangeByRow.insert(bracket.row, ranges.size());
+                    ranges << range;
+                } else if (row > ranges.at(index).endRow) {
+                    ranges[index] = range;
+                }
+                break;
+            }
+            }
+        }
+    }
+
+    std::sort(ranges.begin(), ranges.end(), startsEarlier);
+    return ranges;
+}
+
+QVector<Range> compute(const QStringList &lines, Editor::FoldMethod method)
+{
+    switch (method) {
+    case Editor::FoldBrackets:
+        return byBrackets(lines);
+    default:
+        return byIndentation(lines);
+    }
+}
+
+} // namespace Folding
+
+} // namespace Novile
@@ -0,0 +1,60 @@
+/*
+ * This file is part of the Novile Editor
+ * This program is free software licensed under the GNU LGPL. You can
+ * find a copy of this license in LICENSE in the top directory of
+ * the source code.
+ *
+ * Copyright 2013    Illya Kovalevskyy   <illya.kovalevskyy@gmail.com>
+ *
+ */
+
+#ifndef FOLDING_P_H
+#define FOLDING_P_H
+
+#include <QtCore/QStringList>
+#include <QtCore/QVector>
+
+#include "editor.h"
+
+namespace Novile
+{
+
+/**
+ * @brief Fold range providers
+ *
+ * Functions are thread-safe, they walk the lines once and are meant to
+ * be run in workers. There is at most one range per start row.
+ */
+namespace Folding
+{
+
+/**
+ * @brief Blocks of lines, indented deeper than the line before them
+ * @param lines document lines
+ * @param tabSize width of the tab character in columns
+ * @return fold ranges, sorted by start row
+ */
+QVector<Range> byIndentation(const QStringList &lines, int tabSize = 4);
+
+/**
+ * @brief Multiline blocks between matching brackets: {}, [] and ()
+ *
+ * Brackets inside quoted strings are skipped, comments are not known
+ * @param lines document lines
+ * @return fold ranges, sorted by start row
+ */
+QVector<Range> byBrackets(const QStringList &lines);
+
+/**
+ * @brief Compute fold ranges with the @p method
+ * @param lines document lines
+ * @param method provider
+ * @return fold ranges, sorted by start row
+ */
+QVector<Range> compute(const QStringList &lines, Editor::FoldMethod method);
+
+} // namespace Folding
+
+} // namespace Novile
+
+#endif // FOLDING_P_H
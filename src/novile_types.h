@@ -0,0 +1,179 @@
+/*
+ * This file is part of the Novile Editor
+ * This program is free software licensed under the GNU LGPL. You can
+ * find a copy of this license in LICENSE in the top directory of
+ * the source code.
+ *
+ * Copyright 2013    Illya Kovalevskyy   <illya.kovalevskyy@gmail.com>
+ *
+ */
+
+#ifndef NOVILE_TYPES_H
+#define NOVILE_TYPES_H
+
+#include <QtCore/QString>
+#include <QtCore/QHash>
+#include <QtCore/QMetaType>
+
+namespace Novile
+{
+
+/**
+ * @brief The Range struct
+ *
+ * Range represents a part of the document between two positions:
+ * start (inclusive) and end (exclusive)
+ */
+struct Range
+{
+    Range() :
+        startRow(0), startColumn(0), endRow(0), endColumn(0)
+    {
+    }
+
+    Range(int startRow, int startColumn, int endRow, int endColumn) :
+        startRow(startRow), startColumn(startColumn),
+        endRow(endRow), endColumn(endColumn)
+    {
+    }
+
+    /**
+     * @brief Are start and end positions the same?
+     * @return is it?
+     */
+    bool isEmpty() const
+    {
+        return startRow == endRow && startColumn == endColumn;
+    }
+
+    bool operator==(const Range &other) const
+    {
+        return startRow == other.startRow && startColumn == other.startColumn &&
+               endRow == other.endRow && endColumn == other.endColumn;
+    }
+
+    bool operator!=(const Range &other) const
+    {
+        return !(*this == other);
+    }
+
+    int startRow;
+    int startColumn;
+    int endRow;
+    int endColumn;
+};
+
+inline uint qHash(const Range &range, uint seed = 0)
+{
+    return uint(range.startRow * 31 + range.startColumn) ^
+           (uint(range.endRow * 131 + range.endColumn) << 7) ^ seed;
+}
+
+/**
+ * @brief The Annotation struct
+ *
+ * Annotation is a message shown in the gutter (left margin) of the line
+ */
+struct Annotation
+{
+    /**
+     * @brief Kind of the annotation, defines its icon
+     */
+    enum Type {
+        /// Error message
+        Error = 0,
+        /// Warning message
+        Warning,
+        /// Informational message
+        Info
+    };
+
+    Annotation() :
+        row(0), column(0), type(Error)
+    {
+    }
+
+    Annotation(int row, int column, const QString &text, Type type = Error) :
+        row(row), column(column), text(text), type(type)
+    {
+    }
+
+    bool operator==(const Annotation &other) const
+    {
+        return row == other.row && column == other.column &&
+               type == other.type && text == other.text;
+    }
+
+    bool operator!=(const Annotation &other) const
+    {
+        return !(*this == other);
+    }
+
+    int row;
+    int column;
+    QString text;
+    Type type;
+};
+
+/**
+ * @brief The TextChange struct
+ *
+ * TextChange is a single edit of the document: @c range (in coordinates
+ * of the previous version) is replaced with @c text. Removal has empty
+ * text, insertion has empty range.
+ */
+struct TextChange
+{
+    TextChange() :
+        version(0)
+    {
+    }
+
+    TextChange(const Range &range, const QString &text, int version) :
+        range(range), text(text), version(version)
+    {
+    }
+
+    Range range;
+    QString text;
+    int version;    ///< version of the document after the change
+};
+
+/**
+ * @brief The DiffHunk struct
+ *
+ * DiffHunk is a block of changed lines: @c oldCount lines from
+ * @c oldStart of the old document are replaced with @c newCount lines
+ * from @c newStart of the new one. One of the counts may be zero.
+ */
+struct DiffHunk
+{
+    DiffHunk() :
+        oldStart(0), oldCount(0), newStart(0), newCount(0)
+    {
+    }
+
+    DiffHunk(int oldStart, int oldCount, int newStart, int newCount) :
+        oldStart(oldStart), oldCount(oldCount),
+        newStart(newStart), newCount(newCount)
+    {
+    }
+
+    int oldStart;
+    int oldCount;
+    int newStart;
+    int newCount;
+};
+
+} // namespace Novile
+
+Q_DECLARE_TYPEINFO(Novile::Range, Q_PRIMITIVE_TYPE);
+Q_DECLARE_TYPEINFO(Novile::Annotation, Q_MOVABLE_TYPE);
+Q_DECLARE_TYPEINFO(Novile::TextChange, Q_MOVABLE_TYPE);
+Q_DECLARE_TYPEINFO(Novile::DiffHunk, Q_PRIMITIVE_TYPE);
+Q_DECLARE_METATYPE(Novile::Range)
+Q_DECLARE_METATYPE(Novile::Annotation)
+Q_DECLARE_METATYPE(Novile::TextChange)
+Q_DECLARE_METATYPE(Novile::DiffHunk)
+
+#endif // NOVILE_TYPES_H
@@ -0,0 +1,262 @@
+/*
+ * This file is part of the Novile Editor
+ * This program is free software licensed under the GNU LGPL. You can
+ * find a copy of this license in LICENSE in the top directory of
+ * the source code.
+ *
+ * Copyright 2013    Illya Kovalevskyy   <illya.kovalevskyy@gmail.com>
+ *
+ */
+
+#include <cstring>
+
+#include <QtCore/QFile>
+#include <QtCore/QSaveFile>
+#include <QtCore/QSysInfo>
+#include <QtCore/QTextCodec>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NOVILE_HAVE_SSE2
+#endif
+
+#include "novile_debug.h"
+#include "textfile_p.h"
+
+namespace Novile
+{
+
+namespace TextFile
+{
+
+/**
+ * @brief Widen leading ASCII bytes of @p src into @p dst
+ * @return number of converted bytes
+ */
+static inline int convertAscii(const uchar *src, int size, ushort *dst)
+{
+    int i = 0;
+#ifdef NOVILE_HAVE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= size; i += 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        if (_mm_movemask_epi8(chunk))
+            break;
+
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_unpacklo_epi8(chunk, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i + 8), _mm_unpackhi_epi8(chunk, zero));
+    }
+#endif
+    for (; i < size && src[i] < 0x80; ++i)
+        dst[i] = src[i];
+
+    return i;
+}
+
+bool decodeUtf8(const char *data, int size, QString *text)
+{
+    const uchar *src = reinterpret_cast<const uchar *>(data);
+
+    // UTF-16 never needs more code units than UTF-8 needs bytes
+    QString result(size, Qt::Uninitialized);
+    ushort *dst = reinterpret_cast<ushort *>(result.data());
+    ushort *out = dst;
+
+    int i = 0;
+    while (i < size) {
+        const int ascii = convertAscii(src + i, size - i, out);
+        i += ascii;
+        out += ascii;
+        if (i == size)
+            break;
+
+        const uchar lead = src[i];
+        int trail;
+        uint code;
+        if (lead >= 0xC2 && lead <= 0xDF) {
+            trail = 1;
+            code = lead & 0x1F;
+        } else if (lead >= 0xE0 && lead <= 0xEF) {
+            trail = 2;
+            code = lead & 0x0F;
+        } else if (lead >= 0xF0 && lead <= 0xF4) {
+            trail = 3;
+            code = lead & 0x07;
+        } else {
+            return false;
+        }
+
+        if (i + trail >= size)
+            return false;
+
+        for (int k = 1; k <= trail; ++k) {
+            const uchar byte = src[i + k];
+            if ((byte & 0xC0) != 0x80)
+                return false;
+            code = (code << 6) | (byte & 0x3F);
+        }
+
+        // Overlong forms, surrogates and code points after U+10FFFF
+        if (trail == 2 && (code < 0x800 || (code >= 0xD800 && code <= 0xDFFF)))
+            return false;
+        if (trail == 3 && (code < 0x10000 || code > 0x10FFFF))
+            return false;
+
+        if (code >= 0x10000) {
+            *out++ = QChar::highSurrogate(code);
+            *out++ = QChar::lowSurrogate(code);
+        } else {
+            *out++ = ushort(code);
+        }
+        i += trail + 1;
+    }
+
+    result.resize(out - dst);
+    *text = result;
+    return true;
+}
+
+/**
+ * @brief Decode UTF-16 in the byte order of @p encoding
+ *
+ * Odd trailing byte (truncated file) becomes U+FFFD
+ */
+static QString decodeUtf16(const char *data, int size, const QByteArray &encoding)
+{
+    const int units = size / 2;
+    const bool little = encoding == "UTF-16LE";
+
+    QString result;
+    if (little == (QSysInfo::ByteOrder == QSysInfo::LittleEndian)) {
+        // Native byte order: plain copy
+        result = QString(units, Qt::Uninitialized);
+        memcpy(result.data(), data, units * sizeof(QChar));
+    } else {
+        result = QTextCodec::codecForName(encoding)->toUnicode(data, units * 2);
+    }
+
+    if (size % 2)
+        result.append(QChar(QChar::ReplacementCharacter));
+    return result;
+}
+
+/**
+ * @brief Guess UTF-16 without BOM: ASCII text has every second byte zero
+ */
+static QByteArray guessUtf16(const uchar *data, int size)
+{
+    const int probe = qMin(size, 512) & ~1;
+    if (probe < 2)
+        return QByteArray();
+
+    int evenZeros = 0, oddZeros = 0;
+    for (int i = 0; i < probe; i += 2) {
+        evenZeros += data[i] == 0;
+        oddZeros += data[i + 1] == 0;
+    }
+
+    const int half = probe / 2;
+    if (oddZeros > half * 3 / 4 && evenZeros < half / 8)
+        return "UTF-16LE";
+    if (evenZeros > half * 3 / 4 && oddZeros < half / 8)
+        return "UTF-16BE";
+    return QByteArray();
+}
+
+QString decode(const QByteArray &data, QByteArray *encoding, bool *bom)
+{
+    const uchar *bytes = reinterpret_cast<const uchar *>(data.constData());
+    const int size = data.size();
+
+    *bom = true;
+    if (size >= 3 && bytes[0] == 0xEF && bytes[1] == 0xBB && bytes[2] == 0xBF) {
+        *encoding = "UTF-8";
+        QString text;
+        if (decodeUtf8(data.constData() + 3, size - 3, &text))
+            return text;
+        // Broken sequences are replaced with U+FFFD
+        return QString::fromUtf8(data.constData() + 3, size - 3);
+    }
+
+    if (size >= 4 && bytes[0] == 0xFF && bytes[1] == 0xFE && bytes[2] == 0 && bytes[3] == 0) {
+        *encoding = "UTF-32LE";
+        return QTextCodec::codecForName(*encoding)->toUnicode(data.constData() + 4, size - 4);
+    }
+
+    if (size >= 4 && bytes[0] == 0 && bytes[1] == 0 && bytes[2] == 0xFE && bytes[3] == 0xFF) {
+        *encoding = "UTF-32BE";
+        return QTextCodec::codecForName(*encoding)->toUnicode(data.constData() + 4, size - 4);
+    }
+
+    if (size >= 2 && bytes[0] == 0xFF && bytes[1] == 0xFE) {
+        *encoding = "UTF-16LE";
+        return decodeUtf16(data.constData() + 2, size - 2, *encoding);
+    }
+
+    if (size >= 2 && bytes[0] == 0xFE && bytes[1] == 0xFF) {
+        *encoding = "UTF-16BE";
+        return decodeUtf16(data.constData() + 2, size - 2, *encoding);
+    }
+
+    *bom = false;
+
+    // UTF-16 is guessed first: UTF-16 of ASCII text is valid UTF-8 as well
+    // (zero bytes are ASCII), but it's never meant to be read so
+    const QByteArray utf16 = guessUtf16(bytes, size);
+    if (!utf16.isEmpty()) {
+        *encoding = utf16;
+        return decodeUtf16(data.constData(), size, *encoding);
+    }
+
+    QString text;
+    if (decodeUtf8(data.constData(), size, &text)) {
+        *encoding = "UTF-8";
+        return text;
+    }
+
+    *encoding = "ISO-8859-1";
+    return QString::fromLatin1(data);
+}
+
+bool read(const QString &fileName, QString *text, QByteArray *encoding, bool *bom)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    *text = decode(file.readAll(), encoding, bom);
+    return true;
+}
+
+bool write(const QString &fileName, const QStringList &lines, const QString &newLine,
+           const QByteArray &encoding, bool bom)
+{
+    QTextCodec *codec = QTextCodec::codecForName(encoding);
+    if (!codec) {
+        mDebug() << "Unknown encoding" << encoding << ", UTF-8 is used";
+        codec = QTextCodec::codecForName("UTF-8");
+    }
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    // Line by line: the whole document is never duplicated in memory
+    QTextEncoder *encoder = codec->makeEncoder(QTextCodec::IgnoreHeader);
+    if (bom)
+        file.write(encoder->fromUnicode(QString(QChar(QChar::ByteOrderMark))));
+
+    const QByteArray separator = encoder->fromUnicode(newLine);
+    for (int i = 0; i < lines.size(); ++i) {
+        if (i > 0)
+            file.write(separator);
+        file.write(encoder->fromUnicode(lines.at(i)));
+    }
+    delete encoder;
+
+    return file.commit();
+}
+
+} // namespace TextFile
+
+} // namespace Novile
@@ -0,0 +1,83 @@
+/*
+ * This file is part of the Novile Editor
+ * This program is free software licensed under the GNU LGPL. You can
+ * find a copy of this license in LICENSE in the top directory of
+ * the source code.
+ *
+ * Copyright 2013    Illya Kovalevskyy   <illya.kovalevskyy@gmail.com>
+ *
+ */
+
+#ifndef TEXTFILE_P_H
+#define TEXTFILE_P_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+
+namespace Novile
+{
+
+/**
+ * @brief Reading and writing of the text files
+ *
+ * Functions are thread-safe, so they can (and should) be run in workers
+ */
+namespace TextFile
+{
+
+/**
+ * @brief Decode file contents, detecting its encoding
+ *
+ * Byte order marks of UTF-8, UTF-16 and UTF-32 are recognized. Files
+ * without BOM are decoded as UTF-16 if they look like it (every second
+ * byte is zero), as UTF-8 if they are valid UTF-8 and as Latin-1 otherwise.
+ * @param data raw file contents
+ * @param encoding detected codec name (output)
+ * @param bom did data start with byte order mark? (output)
+ * @return decoded text (without BOM)
+ */
+QString decode(const QByteArray &data, QByteArray *encoding, bool *bom);
+
+/**
+ * @brief Decode UTF-8 with validation
+ *
+ * ASCII runs are converted with SSE2 (if available) 16 bytes at a time
+ * @param data source bytes
+ * @param size number of bytes
+ * @param text decoded text (output, only if data is valid)
+ * @return is @p data valid UTF-8?
+ */
+bool decodeUtf8(const char *data, int size, QString *text);
+
+/**
+ * @brief Read the whole file and decode it
+ * @param fileName source file
+ * @param text decoded text (output)
+ * @param encoding detected codec name (output)
+ * @param bom did file start with byte order mark? (output)
+ * @return is file read?
+ * @see decode()
+ */
+bool read(const QString &fileName, QString *text, QByteArray *encoding, bool *bom);
+
+/**
+ * @brief Encode @p lines and write them to the file atomically
+ *
+ * Data is written to the temporary file, which replaces @p fileName
+ * only if everything has been written.
+ * @param fileName destination file
+ * @param lines document lines
+ * @param newLine line separator, e.g. "\r\n"
+ * @param encoding name of the codec, e.g. "UTF-8"
+ * @param bom write byte order mark or not
+ * @return is file saved?
+ */
+bool write(const QString &fileName, const QStringList &lines, const QString &newLine,
+           const QByteArray &encoding, bool bom = false);
+
+} // namespace TextFile
+
+} // namespace Novile
+
+#endif // TEXTFILE_P_H
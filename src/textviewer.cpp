@@ -0,0 +1,718 @@
+/*
+ * This file is part of the Novile Editor
+ * This program is free software licensed under the GNU LGPL. You can
+ * find a copy of this license in LICENSE in the top directory of
+ * the source code.
+ *
+ * Copyright 2013    Illya Kovalevskyy   <illya.kovalevskyy@gmail.com>
+ *
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include <QtCore>
+#include <QtConcurrent>
+#include <QApplication>
+#include <QClipboard>
+#include <QKeyEvent>
+#include <QPainter>
+#include <QScrollBar>
+#include <QStaticText>
+
+#include "textviewer.h"
+#include "documentstore_p.h"
+
+namespace Novile
+{
+
+// Lines are cut, when they are shown, after that many columns
+static const int MaxShownColumns = 4096;
+
+// Lines are decoded up to that many bytes
+static const int MaxLineBytes = 64 * 1024;
+
+// Laid out lines, which are kept for scrolling back and forth
+static const int GlyphCacheLines = 1024;
+
+static const int TabSize = 4;
+static const int GutterPadding = 6;
+
+/**
+ * @brief Lines of the shown document
+ */
+class LineSource
+{
+public:
+    virtual ~LineSource() {}
+    virtual int count() const = 0;
+    virtual QString line(int row) const = 0;
+};
+
+/**
+ * @brief Lines in memory (shared with the caller)
+ */
+class ListSource : public LineSource
+{
+public:
+    explicit ListSource(const QStringList &lines) :
+        m_lines(lines.isEmpty() ? QStringList(QString()) : lines)
+    {
+    }
+
+    int count() const
+    {
+        return m_lines.size();
+    }
+
+    QString line(int row) const
+    {
+        return m_lines.at(row);
+    }
+
+private:
+    QStringList m_lines;
+};
+
+/**
+ * @brief Memory-mapped file with offsets of the lines
+ *
+ * Only offsets are kept in memory, lines are decoded on demand
+ */
+class MappedSource : public LineSource
+{
+public:
+    explicit MappedSource(const QString &fileName) :
+        file(fileName),
+        data(0),
+        size(0)
+    {
+    }
+
+    /**
+     * @brief Open and map the file
+     * @return is it mapped?
+     */
+    bool open()
+    {
+        if (!file.open(QIODevice::ReadOnly))
+            return false;
+
+        size = file.size();
+        if (size == 0)
+            return true;
+
+        data = file.map(0, size);
+        return data != 0;
+    }
+
+    /**
+     * @brief Find starts of the lines (thread-safe)
+     *
+     * File is scanned in chunks, @p cancelled is checked after each of them
+     * @param data contents of the file
+     * @param size size of the contents
+     * @param cancelled flag, which stops indexing (result is incomplete then)
+     * @return offsets of the lines, the first one is 0
+     */
+    static QVector<qint64> index(const uchar *data, qint64 size, const QAtomicInt *cancelled)
+    {
+        QVector<qint64> starts;
+        starts << 0;
+
+        const uchar *position = data;
+        const uchar *end = data + size;
+        while (position < end && !cancelled->load()) {
+            const uchar *chunkEnd = end - position > IndexChunk ? position + IndexChunk : end;
+            while (position < chunkEnd) {
+                const void *found = std::memchr(position, '\n', chunkEnd - position);
+                if (!found) {
+                    position = chunkEnd;
+                    break;
+                }
+
+                position = static_cast<const uchar *>(found) + 1;
+                starts << (position - data);
+            }
+        }
+        return starts;
+    }
+
+    int count() const
+    {
+        return starts.size();
+    }
+
+    QString line(int row) const
+    {
+        const qint64 start = starts.at(row);
+        qint64 end = row + 1 < starts.size() ? starts.at(row + 1) - 1 : size;
+        if (end > start && data[end - 1] == '\r')
+            --end;
+
+        const int length = int(qMin<qint64>(end - start, MaxLineBytes));
+        return QString::fromUtf8(reinterpret_cast<const char *>(data + start), length);
+    }
+
+    // Bytes, scanned between checks of the cancel flag
+    enum { IndexChunk = 4 * 1024 * 1024 };
+
+    QFile file;
+    uchar *data;
+    qint64 size;
+    QVector<qint64> starts;
+    // Set, when the file isn't needed anymore while it's being indexed
+    QAtomicInt cancelled;
+};
+
+class TextViewerPrivate
+{
+public:
+    /**
+     * @brief Colored ranges, sorted by start row
+     */
+    struct Layer
+    {
+        Layer() : maxSpan(0) {}
+
+        QVector<Range> ranges;
+        // The most lines of a range, so ranges over a row are found
+        // with a binary search
+        int maxSpan;
+        QColor color;
+    };
+
+    TextViewerPrivate() :
+        source(new ListSource(QStringList())),
+        pending(0),
+        lineHeight(1),
+        charWidth(1),
+        currentRow(0),
+        shownFirstRow(0),
+        widestColumns(0),
+        glyphs(GlyphCacheLines)
+    {
+    }
+
+    ~TextViewerPrivate()
+    {
+        cancelLoading();
+        delete source;
+    }
+
+    /**
+     * @brief Replace the document
+     * @param newSource lines (owned by the viewer)
+     */
+    void setSource(LineSource *newSource)
+    {
+        delete source;
+        source = newSource;
+
+        glyphs.clear();
+        widestColumns = 0;
+        currentRow = qMin(currentRow, source->count() - 1);
+    }
+
+    /**
+     * @brief Forget the file, which is being indexed
+     */
+    void cancelLoading()
+    {
+        if (!pending)
+            return;
+
+        // Indexing stops at the next chunk, so waiting is short
+        pending->cancelled.store(1);
+        watcher.waitForFinished();
+        delete pending;
+        pending = 0;
+
+        loadResult.reportResult(false);
+        loadResult.reportFinished();
+    }
+
+    /**
+     * @brief Text of the line, as it's drawn: tabs are expanded, long
+     * lines are cut, invisibles are replaced with symbols
+     * @param line contents of the line
+     * @return shown text
+     */
+    QString shownText(const QString &line) const
+    {
+        const bool invisibles = settings.isInvisiblesShown();
+
+        QString shown;
+        shown.reserve(qMin(line.size(), MaxShownColumns));
+        for (int i = 0; i < line.size() && shown.size() < MaxShownColumns; ++i) {
+            const QChar symbol = line.at(i);
+            if (symbol == QLatin1Char('\t')) {
+                const int spaces = TabSize - shown.size() % TabSize;
+                if (invisibles)
+                    shown += QChar(0x2192) + QString(spaces - 1, QLatin1Char(' '));
+                else
+                    shown += QString(spaces, QLatin1Char(' '));
+            } else if (symbol == QLatin1Char(' ') && invisibles) {
+                shown += QChar(0x00b7);
+            } else {
+                shown += symbol;
+            }
+        }
+        return shown;
+    }
+
+    /**
+     * @brief Column, where the position is drawn (tabs are expanded)
+     * @param line contents of the line
+     * @param column position in the line
+     * @return shown column
+     */
+    static int shownColumn(const QString &line, int column)
+    {
+        column = qMin(column, line.size());
+
+        int shown = 0;
+        for (int i = 0; i < column; ++i) {
+            if (line.at(i) == QLatin1Char('\t'))
+                shown += TabSize - shown % TabSize;
+            else
+                ++shown;
+        }
+        return shown;
+    }
+
+    /**
+     * @brief Laid out text of the line, cached
+     * @param row line number
+     * @return text (valid until the next call)
+     */
+    QStaticText *glyphsOf(int row)
+    {
+        QStaticText *text = glyphs.object(row);
+        if (text)
+            return text;
+
+        text = new QStaticText(shownText(source->line(row)));
+        text->setTextFormat(Qt::PlainText);
+        text->setPerformanceHint(QStaticText::AggressiveCaching);
+        text->prepare(QTransform(), font);
+        glyphs.insert(row, text);
+        return text;
+    }
+
+    /**
+     * @brief Width of the line numbers
+     * @return pixels (0, if gutter is hidden)
+     */
+    int gutterWidth() const
+    {
+        if (!settings.isGutterShown())
+            return 0;
+
+        const int digits = QString::number(source->count()).size();
+        return digits * charWidth + 2 * GutterPadding;
+    }
+
+    /**
+     * @brief Order of ranges in a layer
+     * @return does @p first start on an earlier line?
+     */
+    static bool startsBefore(const Range &first, const Range &second)
+    {
+        return first.startRow < second.startRow;
+    }
+
+    /**
+     * @brief First range of the layer, which can cover the row
+     * @param layer marker layer
+     * @param row line number
+     * @return index of the range
+     */
+    static int firstRangeOver(const Layer &layer, int row)
+    {
+        const int from = row - layer.maxSpan;
+
+        int lo = 0;
+        int hi = layer.ranges.size();
+        while (lo < hi) {
+            const int mid = (lo + hi) / 2;
+            if (layer.ranges.at(mid).startRow < from)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        return lo;
+    }
+
+    LineSource *source;
+
+    // File, which is being indexed in the background
+    MappedSource *pending;
+    QFutureWatcher<QVector<qint64> > watcher;
+    QFutureInterface<bool> loadResult;
+
+    EditorSettings settings;
+    QFont font;
+    int lineHeight;
+    int charWidth;
+
+    int currentRow;
+    int shownFirstRow;
+
+    // Widest shown line, so far (for the horizontal scroll bar)
+    int widestColumns;
+
+    QMap<QString, Layer> layers;
+    QCache<int, QStaticText> glyphs;
+};
+
+TextViewer::TextViewer(QWidget *parent) :
+    QAbstractScrollArea(parent),
+    d(new TextViewerPrivate)
+{
+    d->font.setFamily("monospace");
+    d->font.setStyleHint(QFont::TypeWriter);
+    d->font.setFixedPitch(true);
+
+    setFocusPolicy(Qt::StrongFocus);
+    viewport()->setAutoFillBackground(false);
+
+    connect(&d->watcher, SIGNAL(finished()), SLOT(onIndexed()));
+
+    applySettings(EditorSettings::defaultSettings());
+}
+
+TextViewer::~TextViewer()
+{
+    delete d;
+}
+
+QString TextViewer::text() const
+{
+    QStringList all;
+    all.reserve(d->source->count());
+    for (int row = 0; row < d->source->count(); ++row)
+        all << d->source->line(row);
+    return all.join("\n");
+}
+
+int TextViewer::lines() const
+{
+    return d->source->count();
+}
+
+QString TextViewer::line(int row) const
+{
+    if (row < 0 || row >= d->source->count())
+        return QString();
+
+    return d->source->line(row);
+}
+
+int TextViewer::currentLine() const
+{
+    return d->currentRow;
+}
+
+int TextViewer::firstVisibleLine() const
+{
+    return verticalScrollBar()->value();
+}
+
+int TextViewer::fontSize() const
+{
+    return d->settings.fontSize();
+}
+
+EditorSettings TextViewer::settings() const
+{
+    return d->settings;
+}
+
+void TextViewer::applySettings(const EditorSettings &settings)
+{
+    d->settings = settings;
+    d->font.setPixelSize(settings.fontSize());
+
+    const QFontMetrics metrics(d->font);
+    d->lineHeight = qMax(metrics.height(), 1);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 11, 0)
+    d->charWidth = qMax(metrics.horizontalAdvance(QLatin1Char('x')), 1);
+#else
+    d->charWidth = qMax(metrics.width(QLatin1Char('x')), 1);
+#endif
+
+    d->glyphs.clear();
+    updateScrollBars();
+    viewport()->update();
+}
+
+QFuture<bool> TextViewer::loadFromFileAsync(const QString &fileName)
+{
+    d->cancelLoading();
+
+    MappedSource *source = new MappedSource(fileName);
+    QFutureInterface<bool> result;
+    result.reportStarted();
+
+    if (!source->open()) {
+        delete source;
+        result.reportResult(false);
+        result.reportFinished();
+        return result.future();
+    }
+
+    d->pending = source;
+    d->loadResult = result;
+    d->watcher.setFuture(QtConcurrent::run(MappedSource::index,
+                                           const_cast<const uchar *>(source->data),
+                                           source->size,
+                                           const_cast<const QAtomicInt *>(&source->cancelled)));
+    return result.future();
+}
+
+void TextViewer::setText(const QString &newText)
+{
+    d->cancelLoading();
+    d->setSource(new ListSource(DocumentStore::splitLines(newText)));
+    resetView();
+}
+
+void TextViewer::setLines(const QStringList &lines)
+{
+    d->cancelLoading();
+    d->setSource(new ListSource(lines));
+    resetView();
+}
+
+void TextViewer::setSnapshot(const DocumentSnapshot &snapshot)
+{
+    setLines(snapshot.lines());
+}
+
+void TextViewer::setCurrentLine(int row)
+{
+    row = qBound(0, row, d->source->count() - 1);
+    if (row == d->currentRow)
+        return;
+
+    d->currentRow = row;
+
+    const int first = verticalScrollBar()->value();
+    const int rows = verticalScrollBar()->pageStep();
+    if (row < first)
+        verticalScrollBar()->setValue(row);
+    else if (row >= first + rows)
+        verticalScrollBar()->setValue(row - rows + 1);
+
+    viewport()->update();
+    emit currentLineChanged(row);
+}
+
+void TextViewer::setFirstVisibleLine(int row)
+{
+    verticalScrollBar()->setValue(row);
+}
+
+void TextViewer::setFontSize(int px)
+{
+    EditorSettings changed = d->settings;
+    changed.setFontSize(px);
+    applySettings(changed);
+}
+
+void TextViewer::setMarkers(const QString &layer, const QVector<Range> &ranges)
+{
+    TextViewerPrivate::Layer &markers = d->layers[layer];
+    markers.ranges = ranges;
+    markers.maxSpan = 0;
+
+    // Ranges are sorted by start row (there can be millions of them)
+    std::sort(markers.ranges.begin(), markers.ranges.end(), TextViewerPrivate::startsBefore);
+
+    foreach (const Range &range, markers.ranges)
+        markers.maxSpan = qMax(markers.maxSpan, range.endRow - range.startRow);
+
+    viewport()->update();
+}
+
+void TextViewer::setMarkerColor(const QString &layer, const QColor &color)
+{
+    d->layers[layer].color = color;
+    viewport()->update();
+}
+
+void TextViewer::copy()
+{
+    QApplication::clipboard()->setText(d->source->line(d->currentRow), QClipboard::Clipboard);
+}
+
+void TextViewer::paintEvent(QPaintEvent *event)
+{
+    QPainter painter(viewport());
+    const QPalette &colors = palette();
+    painter.fillRect(event->rect(), colors.base());
+    painter.setFont(d->font);
+
+    const int count = d->source->count();
+    const int first = verticalScrollBar()->value();
+    const int last = qMin(count - 1, first + viewport()->height() / d->lineHeight);
+    const int gutter = d->gutterWidth();
+    const int left = gutter + d->charWidth / 2 - horizontalScrollBar()->value();
+    const int width = viewport()->width();
+
+    painter.setClipRect(gutter, 0, width - gutter, viewport()->height());
+
+    if (d->settings.isActiveLineHighlighted() && d->currentRow >= first && d->currentRow <= last)
+        painter.fillRect(gutter, (d->currentRow - first) * d->lineHeight,
+                         width - gutter, d->lineHeight, colors.alternateBase());
+
+    // Markers: only ranges over the visible rows are looked at
+    QMap<QString, TextViewerPrivate::Layer>::const_iterator i = d->layers.constBegin();
+    for (; i != d->layers.constEnd(); ++i) {
+        const TextViewerPrivate::Layer &layer = i.value();
+        if (!layer.color.isValid())
+            continue;
+
+        for (int index = TextViewerPrivate::firstRangeOver(layer, first);
+             index < layer.ranges.size() && layer.ranges.at(index).startRow <= last; ++index) {
+            const Range &range = layer.ranges.at(index);
+            const int from = qMax(range.startRow, first);
+            const int to = qMin(range.endRow, last);
+            for (int row = from; row <= to; ++row) {
+                const QString text = d->source->line(row);
+                const int startColumn = row == range.startRow ?
+                            TextViewerPrivate::shownColumn(text, range.startColumn) : 0;
+                const int endColumn = row == range.endRow ?
+                            TextViewerPrivate::shownColumn(text, range.endColumn) :
+                            TextViewerPrivate::shownColumn(text, text.size()) + 1;
+
+                painter.fillRect(left + startColumn * d->charWidth, (row - first) * d->lineHeight,
+                                 (endColumn - startColumn) * d->charWidth, d->lineHeight,
+                                 layer.color);
+            }
+        }
+    }
+
+    // Text: laid out lines come from the cache
+    painter.setPen(colors.color(QPalette::Text));
+    int widest = d->widestColumns;
+    for (int row = first; row <= last; ++row) {
+        const QStaticText *text = d->glyphsOf(row);
+        painter.drawStaticText(left, (row - first) * d->lineHeight, *text);
+        widest = qMax(widest, text->text().size());
+    }
+
+    // Line numbers
+    if (gutter > 0) {
+        painter.setClipping(false);
+        painter.fillRect(0, 0, gutter, viewport()->height(), colors.window());
+        painter.setPen(colors.color(QPalette::Disabled, QPalette::Text));
+        for (int row = first; row <= last; ++row) {
+            painter.drawText(0, (row - first) * d->lineHeight, gutter - GutterPadding,
+                             d->lineHeight, Qt::AlignRight | Qt::AlignVCenter,
+                             QString::number(row + 1));
+        }
+    }
+
+    if (widest > d->widestColumns) {
+        d->widestColumns = widest;
+        updateScrollBars();
+    }
+}
+
+void TextViewer::resizeEvent(QResizeEvent *event)
+{
+    QAbstractScrollArea::resizeEvent(event);
+    updateScrollBars();
+}
+
+void TextViewer::keyPressEvent(QKeyEvent *event)
+{
+    if (event->matches(QKeySequence::Copy)) {
+        copy();
+        return;
+    }
+
+    const int page = verticalScrollBar()->pageStep();
+    switch (event->key()) {
+    case Qt::Key_Up:
+        setCurrentLine(d->currentRow - 1);
+        break;
+    case Qt::Key_Down:
+        setCurrentLine(d->currentRow + 1);
+        break;
+    case Qt::Key_PageUp:
+        setCurrentLine(d->currentRow - page);
+        break;
+    case Qt::Key_PageDown:
+        setCurrentLine(d->currentRow + page);
+        break;
+    case Qt::Key_Home:
+        setCurrentLine(0);
+        break;
+    case Qt::Key_End:
+        setCurrentLine(d->source->count() - 1);
+        break;
+    default:
+        QAbstractScrollArea::keyPressEvent(event);
+    }
+}
+
+void TextViewer::mousePressEvent(QMouseEvent *event)
+{
+    setCurrentLine(verticalScrollBar()->value() + event->pos().y() / d->lineHeight);
+    QAbstractScrollArea::mousePressEvent(event);
+}
+
+void TextViewer::scrollContentsBy(int dx, int dy)
+{
+    Q_UNUSED(dx);
+    Q_UNUSED(dy);
+
+    viewport()->update();
+
+    const int row = verticalScrollBar()->value();
+    if (row != d->shownFirstRow) {
+        d->shownFirstRow = row;
+        emit firstVisibleLineChanged(row);
+    }
+}
+
+void TextViewer::onIndexed()
+{
+    // Loading has been cancelled
+    if (!d->pending)
+        return;
+
+    MappedSource *source = d->pending;
+    d->pending = 0;
+    source->starts = d->watcher.result();
+    d->setSource(source);
+    resetView();
+
+    d->loadResult.reportResult(true);
+    d->loadResult.reportFinished();
+}
+
+void TextViewer::updateScrollBars()
+{
+    const int rows = qMax(viewport()->height() / d->lineHeight, 1);
+    verticalScrollBar()->setRange(0, qMax(d->source->count() - rows, 0));
+    verticalScrollBar()->setPageStep(rows);
+    verticalScrollBar()->setSingleStep(1);
+
+    const int visible = viewport()->width() - d->gutterWidth();
+    const int textWidth = (d->widestColumns + 1) * d->charWidth;
+    horizontalScrollBar()->setRange(0, qMax(textWidth - visible, 0));
+    horizontalScrollBar()->setPageStep(visible);
+    horizontalScrollBar()->setSingleStep(d->charWidth);
+}
+
+void TextViewer::resetView()
+{
+    updateScrollBars();
+    viewport()->update();
+}
+
+} // namespace Novile
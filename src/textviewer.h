@@ -0,0 +1,207 @@
+/*
+ * This file is part of the Novile Editor
+ * This program is free software licensed under the GNU LGPL. You can
+ * find a copy of this license in LICENSE in the top directory of
+ * the source code.
+ *
+ * Copyright 2013    Illya Kovalevskyy   <illya.kovalevskyy@gmail.com>
+ *
+ */
+
+#ifndef TEXTVIEWER_H
+#define TEXTVIEWER_H
+
+#include <QAbstractScrollArea>
+#include <QColor>
+#include <QStringList>
+#include <QVector>
+#include <QFuture>
+#include "novile_export.h"
+#include "novile_types.h"
+#include "documentsnapshot.h"
+#include "editorsettings.h"
+
+namespace Novile
+{
+
+class TextViewerPrivate;
+
+/**
+ * @brief The TextViewer class
+ *
+ * Read-only viewer, which draws the document with QPainter, without a web
+ * engine: for very large documents and logs. Only visible lines are read
+ * and laid out, laid out lines are cached, so scrolling costs the same
+ * for any size of the document.
+ *
+ * Files are memory-mapped and indexed by lines in the background, lines
+ * are decoded (UTF-8) only when they are shown. Names of the methods are
+ * the same as in Editor. There is no syntax highlighting: lines can be
+ * marked with colored layers (e.g. search results or errors).
+ * @see Editor
+ */
+class NOVILE_EXPORT TextViewer : public QAbstractScrollArea
+{
+    Q_OBJECT
+    Q_PROPERTY(int fontSize READ fontSize WRITE setFontSize)
+public:
+    /**
+     * @brief Regular constructor
+     * @param parent parent widget
+     */
+    explicit TextViewer(QWidget *parent = 0);
+
+    ~TextViewer();
+
+    /**
+     * @brief Source code from the viewer
+     * @return source code (lines are joined with "\n")
+     */
+    QString text() const;
+
+    /**
+     * @brief Count of lines
+     * @return number of lines
+     */
+    int lines() const;
+
+    /**
+     * @brief Get line contents
+     * @param row line number
+     * @return string with line contents
+     */
+    QString line(int row) const;
+
+    /**
+     * @brief Current line (clicked or moved to with keys)
+     * @return line number
+     */
+    int currentLine() const;
+
+    /**
+     * @brief First line, which is visible at the top
+     * @return line number
+     */
+    int firstVisibleLine() const;
+
+    /**
+     * @brief Font size of the text
+     * @return size in pixels
+     */
+    int fontSize() const;
+
+    /**
+     * @brief Visual options of the viewer
+     * @return settings
+     */
+    EditorSettings settings() const;
+
+    /**
+     * @brief Apply visual options
+     *
+     * Font size, gutter, invisibles and active line highlighting are used,
+     * theme is taken from the palette
+     * @param settings new options
+     */
+    void applySettings(const EditorSettings &settings);
+
+    /**
+     * @brief Memory-map the file and index it by lines in the background
+     *
+     * Document is shown when it's indexed. File must stay unchanged while
+     * it's shown, it's read in UTF-8
+     * @param fileName path to the file
+     * @return future with success
+     */
+    QFuture<bool> loadFromFileAsync(const QString &fileName);
+
+public slots:
+    /**
+     * @brief Show the text
+     * @param newText source code
+     */
+    void setText(const QString &newText);
+
+    /**
+     * @brief Show the lines (they are shared, not copied)
+     * @param lines document lines
+     */
+    void setLines(const QStringList &lines);
+
+    /**
+     * @brief Show the snapshot of the document (lines are shared)
+     * @param snapshot snapshot, e.g. Editor::snapshot()
+     */
+    void setSnapshot(const DocumentSnapshot &snapshot);
+
+    /**
+     * @brief Make the line current and scroll to it, if it's not visible
+     * @param row line number
+     */
+    void setCurrentLine(int row);
+
+    /**
+     * @brief Scroll to the line
+     * @param row line, shown at the top
+     */
+    void setFirstVisibleLine(int row);
+
+    /**
+     * @brief Set font size in pixels
+     * @param px size in pixels
+     */
+    void setFontSize(int px);
+
+    /**
+     * @brief Replace ranges of the marker layer
+     * @param layer name of the layer
+     * @param ranges marked ranges (empty vector clears the layer)
+     * @see setMarkerColor()
+     */
+    void setMarkers(const QString &layer, const QVector<Range> &ranges);
+
+    /**
+     * @brief Set color of the marker layer
+     * @param layer name of the layer
+     * @param color background color of the marked text
+     */
+    void setMarkerColor(const QString &layer, const QColor &color);
+
+    /**
+     * @brief Copy current line to the clipboard
+     */
+    void copy();
+
+signals:
+    /**
+     * @brief Current line has been changed
+     * @param row new current line
+     */
+    void currentLineChanged(int row);
+
+    /**
+     * @brief First visible line has been changed (viewer was scrolled)
+     * @param row new first visible line
+     */
+    void firstVisibleLineChanged(int row);
+
+protected:
+    void paintEvent(QPaintEvent *event);
+    void resizeEvent(QResizeEvent *event);
+    void keyPressEvent(QKeyEvent *event);
+    void mousePressEvent(QMouseEvent *event);
+    void scrollContentsBy(int dx, int dy);
+
+private slots:
+    void onIndexed();
+
+private:
+    void updateScrollBars();
+    void resetView();
+
+    TextViewerPrivate * const d;
+};
+
+} // namespace Novile
+
+#endif // TEXTVIEWER_H
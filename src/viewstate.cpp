@@ -0,0 +1,307 @@
+/*
+ * This file is part of the Novile Editor
+ * This program is free software licensed under the GNU LGPL. You can
+ * find a copy of this license in LICENSE in the top directory of
+ * the source code.
+ *
+ * Copyright 2013    Illya Kovalevskyy   <illya.kovalevskyy@gmail.com>
+ *
+ */
+
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDataStream>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+
+#include "viewstate_p.h"
+
+namespace Novile
+{
+
+namespace
+{
+
+// "NVVS": Novile view state
+const quint32 Magic = 0x4e565653;
+const quint16 Format = 2;
+
+// Number of actions of Ace deltas (see deltaActions in wrapper.js)
+const int DeltaActions = 4;
+
+// Ace delta: action, range and text
+const int DeltaStride = 6;
+
+void writeRange(QDataStream &out, const Range &range)
+{
+    out << qint32(range.startRow) << qint32(range.startColumn)
+        << qint32(range.endRow) << qint32(range.endColumn);
+}
+
+Range readRange(QDataStream &in)
+{
+    qint32 startRow, startColumn, endRow, endColumn;
+    in >> startRow >> startColumn >> endRow >> endColumn;
+    return Range(startRow, startColumn, endRow, endColumn);
+}
+
+void writeText(QDataStream &out, const QString &text)
+{
+    out << text.toUtf8();
+}
+
+QString readText(QDataStream &in)
+{
+    QByteArray text;
+    in >> text;
+    return QString::fromUtf8(text);
+}
+
+// Counts are checked against the size of the blob, so broken data
+// doesn't make us allocate gigabytes
+bool readCount(QDataStream &in, int size, int *count)
+{
+    qint32 value;
+    in >> value;
+    *count = value;
+    return in.status() == QDataStream::Ok && value >= 0 && value <= size;
+}
+
+void writeHistory(QDataStream &out, const QVector<ViewState::UndoEntry> &history)
+{
+    out << qint32(history.size());
+    foreach (const ViewState::UndoEntry &entry, history) {
+        out << qint32(entry.size());
+        foreach (const ViewState::Delta &delta, entry) {
+            out << quint8(delta.action);
+            writeRange(out, delta.range);
+            writeText(out, delta.text);
+        }
+    }
+}
+
+bool readHistory(QDataStream &in, int size, QVector<ViewState::UndoEntry> *history)
+{
+    int entries;
+    if (!readCount(in, size, &entries))
+        return false;
+
+    history->resize(entries);
+    for (int i = 0; i < entries; ++i) {
+        int deltas;
+        if (!readCount(in, size, &deltas))
+            return false;
+
+        ViewState::UndoEntry &entry = (*history)[i];
+        entry.resize(deltas);
+        for (int j = 0; j < deltas; ++j) {
+            quint8 action;
+            in >> action;
+            if (action >= DeltaActions)
+                return false;
+
+            entry[j].action = action;
+            entry[j].range = readRange(in);
+            entry[j].text = readText(in);
+        }
+    }
+    return in.status() == QDataStream::Ok;
+}
+
+QJsonArray rangesToScript(const QVector<Range> &ranges)
+{
+    QJsonArray flat;
+    foreach (const Range &range, ranges) {
+        flat.append(range.startRow);
+        flat.append(range.startColumn);
+        flat.append(range.endRow);
+        flat.append(range.endColumn);
+    }
+    return flat;
+}
+
+QJsonArray historyToScript(const QVector<ViewState::UndoEntry> &history)
+{
+    QJsonArray entries;
+    foreach (const ViewState::UndoEntry &entry, history) {
+        QJsonArray flat;
+        foreach (const ViewState::Delta &delta, entry) {
+            flat.append(delta.action);
+            flat.append(delta.range.startRow);
+            flat.append(delta.range.startColumn);
+            flat.append(delta.range.endRow);
+            flat.append(delta.range.endColumn);
+            flat.append(delta.text);
+        }
+        entries.append(flat);
+    }
+    return entries;
+}
+
+} // namespace
+
+ViewState::ViewState() :
+    scrollTop(0),
+    scrollLeft(0),
+    dirtyCounter(0)
+{
+}
+
+ViewState ViewState::fromScript(const QVariant &value)
+{
+    const QVariantMap map = value.toMap();
+
+    ViewState state;
+    state.selections = rangesFromScript(map.value("selections").toList(), 4);
+    state.scrollTop = map.value("scrollTop").toDouble();
+    state.scrollLeft = map.value("scrollLeft").toDouble();
+
+    const QVariantList folds = map.value("folds").toList();
+    state.folds = rangesFromScript(folds, 5);
+    for (int i = 4; i < folds.size(); i += 5)
+        state.foldPlaceholders << folds.at(i).toString();
+
+    state.undo = historyFromScript(map.value("undo").toList());
+    state.redo = historyFromScript(map.value("redo").toList());
+    state.dirtyCounter = map.value("dirty").toInt();
+    return state;
+}
+
+QString ViewState::toScript() const
+{
+    QJsonArray flatFolds;
+    for (int i = 0; i < folds.size(); ++i) {
+        const Range &fold = folds.at(i);
+        flatFolds.append(fold.startRow);
+        flatFolds.append(fold.startColumn);
+        flatFolds.append(fold.endRow);
+        flatFolds.append(fold.endColumn);
+        flatFolds.append(foldPlaceholders.value(i));
+    }
+
+    QJsonObject object;
+    object.insert("selections", rangesToScript(selections));
+    object.insert("scrollTop", scrollTop);
+    object.insert("scrollLeft", scrollLeft);
+    object.insert("folds", flatFolds);
+    object.insert("undo", historyToScript(undo));
+    object.insert("redo", historyToScript(redo));
+    object.insert("dirty", dirtyCounter);
+
+    return QString::fromUtf8(QJsonDocument(object).toJson(QJsonDocument::Compact));
+}
+
+QByteArray ViewState::save() const
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_0);
+
+    out << Magic << Format << document.lines << document.characters << document.hash
+        << qint32(dirtyCounter) << scrollTop << scrollLeft;
+
+    out << qint32(selections.size());
+    foreach (const Range &selection, selections)
+        writeRange(out, selection);
+
+    out << qint32(folds.size());
+    for (int i = 0; i < folds.size(); ++i) {
+        writeRange(out, folds.at(i));
+        writeText(out, foldPlaceholders.value(i));
+    }
+
+    writeHistory(out, undo);
+    writeHistory(out, redo);
+    return data;
+}
+
+bool ViewState::load(const QByteArray &data)
+{
+    QDataStream in(data);
+    in.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic;
+    quint16 format;
+    in >> magic >> format;
+    if (in.status() != QDataStream::Ok || magic != Magic || format != Format)
+        return false;
+
+    ViewState state;
+    qint32 dirty;
+    in >> state.document.lines >> state.document.characters >> state.document.hash
+       >> dirty >> state.scrollTop >> state.scrollLeft;
+    state.dirtyCounter = dirty;
+
+    int count;
+    if (!readCount(in, data.size(), &count))
+        return false;
+    state.selections.resize(count);
+    for (int i = 0; i < count; ++i)
+        state.selections[i] = readRange(in);
+
+    if (!readCount(in, data.size(), &count))
+        return false;
+    state.folds.resize(count);
+    for (int i = 0; i < count; ++i) {
+        state.folds[i] = readRange(in);
+        state.foldPlaceholders << readText(in);
+    }
+
+    if (!readHistory(in, data.size(), &state.undo) ||
+            !readHistory(in, data.size(), &state.redo))
+        return false;
+
+    *this = state;
+    return true;
+}
+
+ViewState::Fingerprint ViewState::fingerprint(const QStringList &lines)
+{
+    Fingerprint result;
+    result.lines = lines.size();
+
+    // Line breaks are hashed too: "a", "b" and "ab" must differ
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    foreach (const QString &line, lines) {
+        result.characters += line.size();
+        hash.addData(line.toUtf8());
+        hash.addData("\n", 1);
+    }
+    result.hash = hash.result();
+    return result;
+}
+
+QVector<Range> ViewState::rangesFromScript(const QVariantList &flat, int stride)
+{
+    QVector<Range> ranges;
+    ranges.reserve(flat.size() / stride);
+    for (int i = 0; i + 3 < flat.size(); i += stride) {
+        ranges << Range(flat.at(i).toInt(), flat.at(i + 1).toInt(),
+                        flat.at(i + 2).toInt(), flat.at(i + 3).toInt());
+    }
+    return ranges;
+}
+
+QVector<ViewState::UndoEntry> ViewState::historyFromScript(const QVariantList &entries)
+{
+    QVector<UndoEntry> history;
+    history.reserve(entries.size());
+    foreach (const QVariant &value, entries) {
+        const QVariantList flat = value.toList();
+
+        UndoEntry entry;
+        entry.reserve(flat.size() / DeltaStride);
+        for (int i = 0; i + DeltaStride <= flat.size(); i += DeltaStride) {
+            Delta delta;
+            delta.action = flat.at(i).toInt();
+            delta.range = Range(flat.at(i + 1).toInt(), flat.at(i + 2).toInt(),
+                                flat.at(i + 3).toInt(), flat.at(i + 4).toInt());
+            delta.text = flat.at(i + 5).toString();
+            entry << delta;
+        }
+        history << entry;
+    }
+    return history;
+}
+
+} // namespace Novile
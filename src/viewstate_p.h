@@ -0,0 +1,131 @@
+/*
+ * This file is part of the Novile Editor
+ * This program is free software licensed under the GNU LGPL. You can
+ * find a copy of this license in LICENSE in the top directory of
+ * the source code.
+ *
+ * Copyright 2013    Illya Kovalevskyy   <illya.kovalevskyy@gmail.com>
+ *
+ */
+
+#ifndef VIEWSTATE_P_H
+#define VIEWSTATE_P_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QStringList>
+#include <QtCore/QVariant>
+#include <QtCore/QVector>
+
+#include "novile_types.h"
+
+namespace Novile
+{
+
+/**
+ * @brief The ViewState class
+ *
+ * State of the Ace session, which isn't a part of the document: selections,
+ * scroll position, folds and undo history (see getViewState() in wrapper.js).
+ *
+ * It is kept in a compact binary form (QDataStream, texts of the undo
+ * history in UTF-8) together with a fingerprint of the document, so history
+ * is never applied to some other text.
+ */
+class ViewState
+{
+public:
+    /**
+     * @brief Change of the document, kept in the undo history (Ace delta)
+     */
+    struct Delta
+    {
+        /// Index of the action: insertText, insertLines, removeText, removeLines
+        int action;
+        Range range;
+        /// Inserted or removed text, lines are terminated with '\n' each
+        QString text;
+    };
+
+    /**
+     * @brief Entry of the undo history: deltas, undone at once
+     */
+    typedef QVector<Delta> UndoEntry;
+
+    /**
+     * @brief Fingerprint of the document: counts of lines and characters
+     * and SHA-1 of the lines in UTF-8 (stable across Qt versions)
+     */
+    struct Fingerprint
+    {
+        Fingerprint() : lines(0), characters(0) {}
+
+        qint32 lines;
+        qint64 characters;
+        QByteArray hash;
+
+        bool operator==(const Fingerprint &other) const
+        {
+            return lines == other.lines && characters == other.characters &&
+                    hash == other.hash;
+        }
+        bool operator!=(const Fingerprint &other) const
+        {
+            return !(*this == other);
+        }
+    };
+
+    ViewState();
+
+    /**
+     * @brief Take the state, returned by getViewState()
+     * @param value object, converted by the bridge
+     * @return state (without the fingerprint)
+     */
+    static ViewState fromScript(const QVariant &value);
+
+    /**
+     * @brief Argument for restoreViewState()
+     * @return JSON text
+     */
+    QString toScript() const;
+
+    /**
+     * @brief Binary form of the state
+     * @return blob for load()
+     */
+    QByteArray save() const;
+
+    /**
+     * @brief Read the state from the binary form
+     * @param data blob, returned by save()
+     * @return is data valid?
+     */
+    bool load(const QByteArray &data);
+
+    /**
+     * @brief Fingerprint of the document: lines and their contents
+     * @param lines document lines
+     * @return fingerprint
+     */
+    static Fingerprint fingerprint(const QStringList &lines);
+
+    QVector<Range> selections;
+    double scrollTop;
+    double scrollLeft;
+    QVector<Range> folds;
+    QStringList foldPlaceholders;
+    QVector<UndoEntry> undo;
+    QVector<UndoEntry> redo;
+    int dirtyCounter;
+
+    /// Fingerprint of the document, the state has been taken for
+    Fingerprint document;
+
+private:
+    static QVector<Range> rangesFromScript(const QVariantList &flat, int stride);
+    static QVector<UndoEntry> historyFromScript(const QVariantList &entries);
+};
+
+} // namespace Novile
+
+#endif // VIEWSTATE_P_H
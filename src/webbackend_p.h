@@ -0,0 +1,81 @@
+/*
+ * This file is part of the Novile Editor
+ * This program is free software licensed under the GNU LGPL. You can
+ * find a copy of this license in LICENSE in the top directory of
+ * the source code.
+ *
+ * Copyright 2013    Illya Kovalevskyy   <illya.kovalevskyy@gmail.com>
+ *
+ */
+
+#ifndef WEBBACKEND_P_H
+#define WEBBACKEND_P_H
+
+#include <QtCore/QString>
+#include <QtCore/QUrl>
+#include <QtCore/QVariant>
+
+class QObject;
+class QWidget;
+
+namespace Novile
+{
+
+/**
+ * @brief The WebBackend class
+ *
+ * Web engine, which hosts Ace: the view, javascript calls to the page and
+ * the object, which receives calls from the page (window.Novile).
+ * One implementation is compiled into the library, it's chosen at build
+ * time: QtWebKit (default) or QtWebEngine with QWebChannel (NOVILE_WEBENGINE).
+ *
+ * QtWebKit runs everything synchronously in the process. QtWebEngine
+ * runs the page in a separate process: run() doesn't wait, evaluate()
+ * waits for the result (calls are done in order), and calls from the
+ * page are delivered by the event loop.
+ */
+class WebBackend
+{
+public:
+    virtual ~WebBackend() {}
+
+    /**
+     * @brief Create the backend, compiled into the library
+     * @param parent parent of the view
+     * @return new backend (owned by the caller)
+     */
+    static WebBackend *create(QWidget *parent);
+
+    /**
+     * @brief Widget, which shows the page
+     * @return view
+     */
+    virtual QWidget *view() const = 0;
+
+    /**
+     * @brief Load the page and wait until it's loaded
+     * @param url page
+     * @param bridge object, which is available for the page as window.Novile
+     * (its public slots are called)
+     * @return is the bridge available for the page? (if it isn't, changes
+     * made in the page never reach C++)
+     */
+    virtual bool load(const QUrl &url, QObject *bridge) = 0;
+
+    /**
+     * @brief Run javascript code, without waiting for the result
+     * @param code javascript source
+     */
+    virtual void run(const QString &code) = 0;
+
+    /**
+     * @brief Run javascript code and wait for the result
+     * @param code javascript source
+     * @return evaluation result
+     */
+    virtual QVariant evaluate(const QString &code) = 0;
+};
+
+} // namespace Novile
+
+#endif // WEBBACKEND_P_H
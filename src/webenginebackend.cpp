@@ -0,0 +1,174 @@
+/*
+ * This file is part of the Novile Editor
+ * This program is free software licensed under the GNU LGPL. You can
+ * find a copy of this license in LICENSE in the top directory of
+ * the source code.
+ *
+ * Copyright 2013    Illya Kovalevskyy   <illya.kovalevskyy@gmail.com>
+ *
+ */
+
+#include <QtCore>
+#include <QWebChannel>
+#include <QWebEnginePage>
+#include <QWebEngineView>
+
+#include "webbackend_p.h"
+
+namespace Novile
+{
+
+/**
+ * @brief The ChannelProbe class
+ *
+ * Object of the channel, which the page calls as soon as its side of the
+ * channel is set up (window.Novile is available from then on)
+ */
+class ChannelProbe : public QObject
+{
+    Q_OBJECT
+public:
+    ChannelProbe() : m_ready(false) {}
+
+    bool isReady() const
+    {
+        return m_ready;
+    }
+
+signals:
+    void readyChanged();
+
+public slots:
+    void ready()
+    {
+        m_ready = true;
+        emit readyChanged();
+    }
+
+private:
+    bool m_ready;
+};
+
+/**
+ * @brief The WebEngineBackend class
+ *
+ * Page is run by QtWebEngine (Chromium) in a separate process. Calls
+ * without results don't wait for the page, calls from the page come
+ * through QWebChannel and are delivered by the event loop.
+ */
+class WebEngineBackend : public WebBackend
+{
+public:
+    // Page has to set up the channel, before Novile is available for it
+    enum { ChannelTimeout = 5000 };
+
+    // Results don't come, if the render process has crashed
+    enum { EvaluateTimeout = 5000 };
+
+    explicit WebEngineBackend(QWidget *parent) :
+        m_view(new QWebEngineView(parent)),
+        m_channel(new QWebChannel(m_view))
+    {
+        // Channel has to be set before loading, so the transport is injected
+        m_view->page()->setWebChannel(m_channel);
+    }
+
+    ~WebEngineBackend()
+    {
+        m_view->deleteLater();
+    }
+
+    QWidget *view() const
+    {
+        return m_view;
+    }
+
+    bool load(const QUrl &url, QObject *bridge)
+    {
+        ChannelProbe probe;
+        m_channel->registerObject("Novile", bridge);
+        m_channel->registerObject("NovileChannel", &probe);
+
+        QEventLoop loop;
+        QObject::connect(m_view, SIGNAL(loadFinished(bool)),
+                &loop, SLOT(quit()));
+
+        m_view->load(url);
+        loop.exec(QEventLoop::ExcludeUserInputEvents);
+
+        // Client side of the channel is shipped with QtWebChannel
+        QFile client(":/qtwebchannel/qwebchannel.js");
+        if (client.open(QIODevice::ReadOnly))
+            run(QString::fromUtf8(client.readAll()));
+
+        run("new QWebChannel(qt.webChannelTransport, function(channel) {"
+            "    window.Novile = channel.objects.Novile;"
+            "    channel.objects.NovileChannel.ready();"
+            "});");
+
+        // Page reports, when the channel is set up
+        QObject::connect(&probe, SIGNAL(readyChanged()), &loop, SLOT(quit()));
+        QTimer::singleShot(ChannelTimeout, &loop, SLOT(quit()));
+        if (!probe.isReady())
+            loop.exec(QEventLoop::ExcludeUserInputEvents);
+
+        m_channel->deregisterObject(&probe);
+        if (!probe.isReady()) {
+            qWarning("Novile: web channel hasn't been set up in %d ms, "
+                     "the page can't reach the editor", int(ChannelTimeout));
+            return false;
+        }
+        return true;
+    }
+
+    void run(const QString &code)
+    {
+        m_view->page()->runJavaScript(code);
+    }
+
+    QVariant evaluate(const QString &code)
+    {
+        // Calls are done in order, so the result comes after all previous
+        // calls have been run; user input waits till then. Result can come
+        // after the timeout, so the callback keeps only shared state
+        struct Reply
+        {
+            Reply() : arrived(false) {}
+            QVariant value;
+            bool arrived;
+        };
+        QSharedPointer<Reply> reply(new Reply);
+
+        QEventLoop loop;
+        QPointer<QEventLoop> waiting(&loop);
+        m_view->page()->runJavaScript(code, [reply, waiting](const QVariant &value) {
+            reply->value = value;
+            reply->arrived = true;
+            if (waiting)
+                waiting->quit();
+        });
+
+        QTimer::singleShot(EvaluateTimeout, &loop, SLOT(quit()));
+        if (!reply->arrived)
+            loop.exec(QEventLoop::ExcludeUserInputEvents);
+
+        if (!reply->arrived) {
+            qWarning("Novile: page hasn't answered in %d ms", int(EvaluateTimeout));
+            return QVariant();
+        }
+        return reply->value;
+    }
+
+private:
+    QWebEngineView *m_view;
+    QWebChannel *m_channel;
+};
+
+WebBackend *WebBackend::create(QWidget *parent)
+{
+    return new WebEngineBackend(parent);
+}
+
+} // namespace Novile
+
+#include "webenginebackend.moc"
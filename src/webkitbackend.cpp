@@ -0,0 +1,79 @@
+/*
+ * This file is part of the Novile Editor
+ * This program is free software licensed under the GNU LGPL. You can
+ * find a copy of this license in LICENSE in the top directory of
+ * the source code.
+ *
+ * Copyright 2013    Illya Kovalevskyy   <illya.kovalevskyy@gmail.com>
+ *
+ */
+
+#include <QtCore>
+
+#include <QtWebKit>
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+#include <QtWebKitWidgets>
+#endif
+
+#include "webbackend_p.h"
+
+namespace Novile
+{
+
+/**
+ * @brief The WebKitBackend class
+ *
+ * Page is run by QtWebKit in the process, so every call is synchronous
+ * and calls from the page reach C++ before run() returns.
+ */
+class WebKitBackend : public WebBackend
+{
+public:
+    explicit WebKitBackend(QWidget *parent) :
+        m_view(new QWebView(parent))
+    {
+    }
+
+    ~WebKitBackend()
+    {
+        m_view->deleteLater();
+    }
+
+    QWidget *view() const
+    {
+        return m_view;
+    }
+
+    bool load(const QUrl &url, QObject *bridge)
+    {
+        QEventLoop loop;
+        QObject::connect(m_view, SIGNAL(loadFinished(bool)),
+                &loop, SLOT(quit()));
+
+        m_view->load(url);
+        loop.exec(QEventLoop::ExcludeUserInputEvents);
+
+        m_view->page()->mainFrame()->addToJavaScriptWindowObject("Novile", bridge);
+        return true;
+    }
+
+    void run(const QString &code)
+    {
+        m_view->page()->mainFrame()->evaluateJavaScript(code);
+    }
+
+    QVariant evaluate(const QString &code)
+    {
+        return m_view->page()->mainFrame()->evaluateJavaScript(code);
+    }
+
+private:
+    QWebView *m_view;
+};
+
+WebBackend *WebBackend::create(QWidget *parent)
+{
+    return new WebKitBackend(parent);
+}
+
+} // namespace Novile